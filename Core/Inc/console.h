@@ -0,0 +1,19 @@
+#ifndef __CONSOLE_H__
+#define __CONSOLE_H__
+
+#include "main.h"
+#include <stdbool.h>
+
+// Single-character commands received on USART2, next to the debug log it sends. The
+// receive interrupt only queues the character, its handler runs from the scheduler.
+// USART2 cannot wake the node from Stop mode, a command sent then is lost.
+#define CONSOLE_COMMAND_MAX 8 // Registered commands
+#define CONSOLE_RX_DEPTH 8    // Characters waiting for the main loop, must be a power of two
+
+typedef void (*ConsoleHandler_t)(void);
+
+void console_init(void);
+bool console_register(char command, ConsoleHandler_t handler);
+void console_rx_error(void);
+
+#endif /* __CONSOLE_H__ */
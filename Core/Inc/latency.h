@@ -0,0 +1,31 @@
+#ifndef __LATENCY_H__
+#define __LATENCY_H__
+
+#include "main.h"
+
+// Lateness of our slot replies: from the end of the poll, time-stamped by the RX path, plus
+// the slot offset, to the reply handed to the USART1 DMA. Bucket 0 counts replies on time
+// to the microsecond, bucket n > 0 those from 2^(n-1) to 2^n - 1 us late, the last bucket
+// everything from 2^(LATENCY_BUCKETS-2) us on.
+// This is the TIM2 callback against the deadline it was armed for, both on the same clock,
+// so it shows the timer and interrupt jitter only. It does not measure when the first byte
+// reaches the wire: the DMA start and the first character time come on top, and an error
+// in the end-of-poll estimate shifts both ends alike. "Early" replies are the timer
+// firing at once for deadlines under ZIGBEE_TIMER_MIN_LEAD_US (4 us) away.
+#define LATENCY_BUCKETS 16
+
+typedef struct {
+    uint32_t buckets[LATENCY_BUCKETS];
+    uint32_t count;
+    uint32_t early;    // Replies sent before their slot, not in the buckets
+    uint32_t max_us;
+    uint64_t total_us;
+} LatencyStats_t;
+
+void latency_init(void);
+void latency_record(int32_t late_us);
+const LatencyStats_t *latency_stats(void);
+void latency_report(void);
+void latency_clear(void);
+
+#endif /* __LATENCY_H__ */
@@ -0,0 +1,43 @@
+#ifndef __LOW_POWER_H__
+#define __LOW_POWER_H__
+
+#include "main.h"
+#include <stdbool.h>
+
+// Stop mode halts every clock, so it is only entered when nothing but a frame can wake
+// the node: no timer on the wheel, no slot reply scheduled and both UARTs drained. The
+// USART1 RX start bit then wakes it through EXTI, but the bytes received before the PLL
+// is back are lost, so the poller must precede each frame with a wake-up byte and leave
+// at least the wake-up latency reported below before the frame itself. Battery builds
+// set it to 1, mains builds keep the node in Sleep mode where nothing is lost.
+#ifndef LOW_POWER_ALLOW_STOP
+#define LOW_POWER_ALLOW_STOP 0
+#endif
+
+#ifndef LOW_POWER_REPORT_MS
+#define LOW_POWER_REPORT_MS 60000 // Measured time between two accounting logs, 0 to disable
+#endif
+
+// Also queue each report for the master as a ZIGBEE_RECORD_POWER reply record. Slot replies
+// are then reply frames rather than the plain ID line, which only newer masters decode.
+#ifndef LOW_POWER_REPLY_RECORDS
+#define LOW_POWER_REPLY_RECORDS 0
+#endif
+
+// Energy/latency accounting. Multiplying the times by the datasheet supply currents of
+// Run (~25 mA at 64 MHz) and Sleep (~15 mA) mode gives the charge drawn; Stop draws a few
+// tens of uA but its length is not measured, TIM2 stops with the clocks.
+typedef struct {
+    uint64_t awake_us;     // Running the CPU
+    uint64_t sleep_us;     // In Sleep mode, peripherals and DMA still clocked
+    uint32_t sleep_count;
+    uint32_t stop_count;
+    uint32_t wake_last_us; // From the Stop wake-up to the system clock being restored
+    uint32_t wake_max_us;
+} LowPowerStats_t;
+
+void low_power_init(void);
+void low_power_idle(void);
+const LowPowerStats_t *low_power_stats(void);
+
+#endif /* __LOW_POWER_H__ */
@@ -0,0 +1,85 @@
+#ifndef __MBMP_H__
+#define __MBMP_H__
+
+#include <stdint.h>
+
+// Size of the decoded bitmap: 64 bytes support up to 512 slave IDs
+#define MBMP_MAX_BITMAP_SIZE 64
+
+// mbmp_hex_lut[] value for characters that are not hex digits
+#define MBMP_HEX_INVALID 0x10
+
+// mbmp_stream_end() results besides a slot number
+#define MBMP_SLOT_NOT_POLLED (-1) // Valid poll, our bit is not set
+#define MBMP_SLOT_NOT_MBMP   (-2) // The line is not an MBMP poll
+#define MBMP_SLOT_MALFORMED  (-3) // MBMP prefix with a broken hex payload, or a broken binary frame
+
+// Binary poll frame: [MBMP_FRAME_SYNC][type][payload length][payload][CRC-8 of type, length
+// and payload]. The length delimits it, no line end follows. About half the bytes of the
+// hex form, and the sync byte never starts a text line, so both forms share the link.
+#define MBMP_FRAME_SYNC 0xD5
+#define MBMP_FRAME_BITMAP 0x01  // Payload is the bitmap itself, in the same bit order as the hex one
+#define MBMP_FRAME_RUNS 0x02    // Payload is run lengths from ID 1, alternately not polled and polled
+#define MBMP_FRAME_IDS 0x03     // Payload is the sorted polled IDs, 16-bit little endian, see below
+#define MBMP_FRAME_REPLY 0x81   // Slave to master: batched records, built by zigbee_reply.c
+#define MBMP_FRAME_OVERHEAD 4   // Sync, type, length and CRC
+#define MBMP_FRAME_MAX_PAYLOAD 128
+
+// MBMP_FRAME_IDS entries: an ID, or MBMP_ID_RANGE | first ID followed by the last ID of a
+// range. IDs go up to MBMP_ID_MAX, strictly increasing, so a few devices in a network far
+// beyond the 512 IDs of a bitmap cost two bytes each.
+#define MBMP_ID_RANGE 0x8000u
+#define MBMP_ID_MAX 0x7FFF
+
+// Incremental MBMP parser, fed one received character at a time. Hex digits are decoded
+// through mbmp_hex_lut[] into a 32-bit word, which is popcounted (SWAR) once per four
+// bitmap bytes rather than per byte. Over a whole line this costs several times what
+// mbmp_decode_hex() plus mbmp_get_response_slot() do (one call and its state per
+// character, Host/mbmp_bench), but it is spread over the byte arrivals: after the
+// '\r' only mbmp_stream_end() is left, where decoding the line would start then.
+typedef struct {
+    uint16_t self_byte_index; // Bitmap byte holding our own bit
+    uint16_t self_hex_end;    // Hex characters up to and including our byte, 0 if our ID is unknown
+    uint32_t hex_word;        // Bitmap bytes decoded since the last popcount, the newest lowest
+    uint8_t self_mask;        // Our bit inside that byte, 0 if our ID is unknown
+    uint8_t prefix_matched;   // Characters of "MBMP:" matched so far
+    uint8_t invalid;          // MBMP_HEX_INVALID once anything malformed was seen
+    uint8_t ended;            // '\r' seen, nothing but the line end may follow
+    int8_t self_polled;       // -1 until our byte is decoded, then 0 or 1
+    uint16_t hex_count;       // Hex characters consumed
+    uint16_t preceding_slaves; // Polled slaves with a lower ID seen so far
+    uint16_t self_id;         // Our ID for run-length frames, 0 if unknown
+    uint8_t frame;            // 1 once the sync byte started a binary frame
+    uint8_t frame_type;       // A poll: BITMAP, RUNS or IDS. Others, REPLY included, are malformed
+    uint8_t frame_len;        // Payload length from the header
+    uint8_t frame_crc;        // CRC-8 of the frame so far
+    uint16_t frame_pos;       // Bytes received after the sync byte
+    uint16_t run_start;       // Run-length frames: first ID of the next run
+    uint8_t entry_low;        // ID list frames: first byte of the entry being received
+    uint16_t range_first;     // ID list frames: first ID of a range waiting for its last one
+    uint16_t last_id;         // ID list frames: highest ID so far, the list must increase
+} MbmpStream_t;
+
+// Decoding a whole poll after it was received. The firmware works the slot out while the
+// poll arrives (mbmp_stream_*), so only the host tools build these, with MBMP_WHOLE_POLL=1.
+#ifndef MBMP_WHOLE_POLL
+#define MBMP_WHOLE_POLL 0
+#endif
+
+extern const uint8_t mbmp_hex_lut[256];
+
+#if MBMP_WHOLE_POLL
+int mbmp_decode_hex(const uint8_t *hex, uint16_t hex_len, uint8_t *bitmap, uint16_t max_bitmap_size);
+int mbmp_get_response_slot(const uint8_t *bitmap, int max_bit, int self_id);
+int mbmp_id_list_get_response_slot(const uint8_t *entries, uint16_t entries_len, int self_id);
+#endif
+
+void mbmp_stream_begin(MbmpStream_t *stream, int self_id);
+void mbmp_stream_feed(MbmpStream_t *stream, uint8_t c);
+int mbmp_stream_end(const MbmpStream_t *stream);
+int mbmp_stream_frame_complete(const MbmpStream_t *stream);
+
+uint8_t mbmp_crc8(uint8_t crc, const uint8_t *data, uint16_t len);
+int mbmp_frame_encode(uint8_t type, const uint8_t *payload, uint16_t payload_len, uint8_t *frame, uint16_t max_frame_len);
+
+#endif /* __MBMP_H__ */
@@ -0,0 +1,60 @@
+#ifndef __PROFILER_H__
+#define __PROFILER_H__
+
+#include "main.h"
+
+// Cycle accounting per code region: PROF_BEGIN() and PROF_END() around the region, in the
+// same block, record min/avg/max cycles. The counts are wall time, interrupts that preempt
+// a region are in it, and a region nested in another counts in both. Builds without
+// PROFILER_ENABLE keep the table but the macros compile to nothing.
+#ifndef PROFILER_ENABLE
+#define PROFILER_ENABLE 1
+#endif
+
+typedef enum {
+    PROF_RX_PARSE,      // USART1 RX event: the DMA ring drained through the line and MBMP parsers
+    PROF_SLOT_SCHEDULE, // Poll received: reply frame built and the slot timer armed
+    PROF_SLOT_TX,       // Slot reply queued on USART1, in the TIM2 interrupt
+    PROF_ZIGBEE_RUN,    // One step of the startup, ID and transmit managers
+    PROF_LOG_WRITE,     // One binary log record packed and queued
+    PROF_REGION_COUNT
+} ProfRegion_t;
+
+typedef struct {
+    uint32_t count;
+    uint32_t min;
+    uint32_t max;
+    uint64_t total;
+} ProfStats_t;
+
+// The DWT cycle counter on the target. The host build has no cycle-exact clock, it counts
+// TSC ticks on x86 and nanoseconds elsewhere.
+#if defined(__arm__) || defined(__ARMCC_VERSION)
+#define profiler_now() (DWT->CYCCNT)
+#elif defined(__x86_64__) || defined(__i386__)
+#define profiler_now() ((uint32_t)__builtin_ia32_rdtsc())
+#else
+#include <time.h>
+static inline uint32_t profiler_now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint32_t)ts.tv_sec * 1000000000u + (uint32_t)ts.tv_nsec;
+}
+#endif
+
+#if PROFILER_ENABLE
+#define PROF_BEGIN(region) const uint32_t prof_start_##region = profiler_now()
+#define PROF_END(region) profiler_record((region), profiler_now() - prof_start_##region)
+#else
+#define PROF_BEGIN(region) ((void)0)
+#define PROF_END(region) ((void)0)
+#endif
+
+void profiler_init(void);
+void profiler_record(ProfRegion_t region, uint32_t cycles);
+const ProfStats_t *profiler_stats(ProfRegion_t region);
+void profiler_report(void);
+void profiler_clear(void);
+
+#endif /* __PROFILER_H__ */
@@ -0,0 +1,36 @@
+#ifndef __SCHEDULER_H__
+#define __SCHEDULER_H__
+
+#include "main.h"
+#include <stdbool.h>
+
+// Events, each one a bit in the pending mask. Posting an event that is already pending
+// does nothing, so a handler must consume everything that caused it.
+typedef enum {
+    SCHED_EVENT_RX_LINE,      // A complete line is in the USART1 RX queue
+    SCHED_EVENT_TX_DONE,      // A UART finished sending a block
+    SCHED_EVENT_ZIGBEE_TIMER, // The Zigbee managers' wake-up timer expired
+    SCHED_EVENT_POWER_REPORT, // Time to log the low-power accounting
+    SCHED_EVENT_CONSOLE,      // A command character arrived on USART2
+    SCHED_EVENT_COUNT
+} SchedEvent_t;
+
+typedef void (*SchedHandler_t)(void);
+
+// One-shot timer on the SysTick wheel, posts its event when it expires
+typedef struct SchedTimer {
+    struct SchedTimer *next;
+    uint16_t rounds; // Full wheel turns left before it expires
+    uint8_t event;
+    bool active;
+} SchedTimer_t;
+
+void scheduler_subscribe(SchedEvent_t event, SchedHandler_t handler);
+void scheduler_post(SchedEvent_t event);
+void scheduler_timer_start(SchedTimer_t *timer, uint32_t delay_ms, SchedEvent_t event);
+void scheduler_timer_stop(SchedTimer_t *timer);
+bool scheduler_timers_active(void);
+void scheduler_tick(void);
+void scheduler_dispatch(void);
+
+#endif /* __SCHEDULER_H__ */
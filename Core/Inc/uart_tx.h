@@ -0,0 +1,15 @@
+#ifndef __UART_TX_H__
+#define __UART_TX_H__
+
+#include "main.h"
+#include <stdbool.h>
+
+// Anything up to a block long goes out in a single DMA transfer, with no gap in it
+#define UART1_TX_BLOCK_SIZE 64 // Longest AT command, GETID request or slot reply frame
+
+void uart_tx_init(void);
+bool uart_tx_write(UART_HandleTypeDef *huart, const uint8_t *data, uint16_t len);
+bool uart_tx_idle(void);
+void uart_tx_abort(UART_HandleTypeDef *huart);
+
+#endif /* __UART_TX_H__ */
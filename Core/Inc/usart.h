@@ -30,16 +30,20 @@ extern "C" {
 
 /* USER CODE BEGIN Includes */
 #include "stdio.h"
+#include "uart_tx.h"
 /* USER CODE END Includes */
 
 extern UART_HandleTypeDef huart1;
 
 extern UART_HandleTypeDef huart2;
 
+extern DMA_HandleTypeDef hdma_usart1_rx;
+
+extern DMA_HandleTypeDef hdma_usart1_tx;
+
+extern DMA_HandleTypeDef hdma_usart2_tx;
+
 /* USER CODE BEGIN Private defines */
-extern uint8_t u_buf[];
-#define U2_printf(...) HAL_UART_Transmit(&huart2,(uint8_t *)u_buf,sprintf((char*)u_buf,__VA_ARGS__),HAL_MAX_DELAY) 
-#define U1_printf(...) HAL_UART_Transmit(&huart1,(uint8_t *)u_buf,sprintf((char*)u_buf,__VA_ARGS__),HAL_MAX_DELAY)
 /* USER CODE END Private defines */
 
 void MX_USART1_UART_Init(void);
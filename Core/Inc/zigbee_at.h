@@ -0,0 +1,61 @@
+#ifndef __ZIGBEE_AT_H__
+#define __ZIGBEE_AT_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define ZIGBEE_AT_MAX_MATCHES 3
+#define ZIGBEE_AT_RETRY_FOREVER 0
+#define ZIGBEE_AT_NO_MSG 0xFF // No log message for this outcome
+
+// Pipelined commands go out this long after the previous one, without waiting for its
+// reply, so the module still sees them as separate frames. Build with 0 to disable.
+#ifndef ZIGBEE_AT_PIPELINE_GAP_MS
+#define ZIGBEE_AT_PIPELINE_GAP_MS 20
+#endif
+
+// One expected reply of a step
+typedef struct {
+    const char *prefix; // Matched against the start of the reply, NULL ends the list
+    uint8_t next;       // Step to run next
+    uint8_t log_msg;    // ZigbeeLogMsg_t logged when it matches
+    uint8_t (*action)(const uint8_t *data, uint16_t len); // Optional, returns the next step instead
+} ZigbeeAtMatch_t;
+
+// One AT transaction: send the command, then wait for one of the expected replies
+typedef struct {
+    const char *command;   // Sent on entry, NULL for a final step that does nothing
+    uint16_t timeout_ms;   // Resend after this long without a reply
+    uint8_t max_retries;   // Resends before going to fail_next, or ZIGBEE_AT_RETRY_FOREVER
+    uint8_t fail_next;     // Step once max_retries is used up
+    uint8_t mismatch_next; // Step after any other reply
+    uint8_t timeout_msg;   // ZigbeeLogMsg_t logged on timeout
+    uint8_t mismatch_msg;  // ZigbeeLogMsg_t logged on any other reply
+    ZigbeeAtMatch_t matches[ZIGBEE_AT_MAX_MATCHES];
+    bool pipelined;        // May be sent before the reply of the step leading here (its first match)
+} ZigbeeAtStep_t;
+
+typedef struct {
+    const ZigbeeAtStep_t *steps; // Indexed by step number
+    uint8_t step;
+    uint8_t retries;
+    bool waiting; // The command is out, waiting for its reply
+    uint8_t ahead; // Pipelined steps after this one whose commands are already out
+    uint8_t stale_step; // First of the stale steps: sent ahead, then left for another path
+    uint8_t stale;      // How many, their replies may still come in
+    uint32_t sent_tick;
+    uint32_t last_tx_tick;
+    uint32_t hold_tick;
+    uint32_t hold_ms;  // Nothing is sent until hold_ms after hold_tick
+    uint32_t enter_tick;
+    uint32_t *phase_ms; // Caller's array, one entry per step: time spent in it, retries included
+} ZigbeeAt_t;
+
+void zigbee_at_start(ZigbeeAt_t *at, const ZigbeeAtStep_t *steps, uint8_t step_count, uint32_t *phase_ms,
+                     uint8_t first);
+void zigbee_at_goto(ZigbeeAt_t *at, uint8_t step);
+void zigbee_at_delay(ZigbeeAt_t *at, uint32_t delay_ms);
+bool zigbee_at_run(ZigbeeAt_t *at, const uint8_t *line, uint16_t len);
+uint32_t zigbee_at_next_ms(const ZigbeeAt_t *at);
+
+#endif /* __ZIGBEE_AT_H__ */
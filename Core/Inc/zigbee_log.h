@@ -0,0 +1,81 @@
+#ifndef __ZIGBEE_LOG_H__
+#define __ZIGBEE_LOG_H__
+
+#include <stdint.h>
+
+/*
+ * Binary debug log on USART2. Each call sends one record
+ *
+ *   ZB_LOG_SYNC | id | payload length | payload | XOR of id, length and payload
+ *
+ * where the payload is the 32-bit arguments, little endian, followed by an optional
+ * text. Host/zigbee_log_decode.c turns a capture back into text using zigbee_log_msgs.h.
+ *
+ * Calls above ZB_LOG_LEVEL are removed by the preprocessor, their arguments included.
+ * Build with e.g. -DZB_LOG_LEVEL=ZB_LOG_LEVEL_WARN to keep only warnings and errors.
+ */
+#define ZB_LOG_LEVEL_NONE  0
+#define ZB_LOG_LEVEL_ERROR 1
+#define ZB_LOG_LEVEL_WARN  2
+#define ZB_LOG_LEVEL_INFO  3
+#define ZB_LOG_LEVEL_DEBUG 4
+
+#ifndef ZB_LOG_LEVEL
+#define ZB_LOG_LEVEL ZB_LOG_LEVEL_DEBUG
+#endif
+
+#define ZB_LOG_SYNC 0xA5
+#define ZB_LOG_PAYLOAD_MAX 176 // Room for a full received line plus a few arguments
+
+typedef enum {
+#define ZB_LOG_MSG(id, format) id,
+#include "zigbee_log_msgs.h"
+#undef ZB_LOG_MSG
+    ZB_MSG_COUNT
+} ZigbeeLogMsg_t;
+
+void zigbee_log_write(uint8_t id, const int32_t *args, uint8_t nargs, const uint8_t *text, uint16_t text_len);
+
+// The message ID goes first in the initialiser, so ZB_LOG_x(ZB_MSG_y) needs no arguments
+#define ZB_LOG_EMIT(...)                                                                     \
+    do {                                                                                     \
+        const int32_t zb_log_args_[] = { __VA_ARGS__ };                                      \
+        zigbee_log_write((uint8_t)zb_log_args_[0], &zb_log_args_[1],                         \
+                         (uint8_t)(sizeof(zb_log_args_) / sizeof(zb_log_args_[0]) - 1), 0, 0); \
+    } while (0)
+
+#define ZB_LOG_EMIT_TEXT(id, text, len) zigbee_log_write((id), 0, 0, (const uint8_t *)(text), (len))
+
+#if ZB_LOG_LEVEL >= ZB_LOG_LEVEL_ERROR
+#define ZB_LOG_ERROR(...) ZB_LOG_EMIT(__VA_ARGS__)
+#define ZB_LOG_ERROR_TEXT(id, text, len) ZB_LOG_EMIT_TEXT(id, text, len)
+#else
+#define ZB_LOG_ERROR(...) ((void)0)
+#define ZB_LOG_ERROR_TEXT(id, text, len) ((void)0)
+#endif
+
+#if ZB_LOG_LEVEL >= ZB_LOG_LEVEL_WARN
+#define ZB_LOG_WARN(...) ZB_LOG_EMIT(__VA_ARGS__)
+#define ZB_LOG_WARN_TEXT(id, text, len) ZB_LOG_EMIT_TEXT(id, text, len)
+#else
+#define ZB_LOG_WARN(...) ((void)0)
+#define ZB_LOG_WARN_TEXT(id, text, len) ((void)0)
+#endif
+
+#if ZB_LOG_LEVEL >= ZB_LOG_LEVEL_INFO
+#define ZB_LOG_INFO(...) ZB_LOG_EMIT(__VA_ARGS__)
+#define ZB_LOG_INFO_TEXT(id, text, len) ZB_LOG_EMIT_TEXT(id, text, len)
+#else
+#define ZB_LOG_INFO(...) ((void)0)
+#define ZB_LOG_INFO_TEXT(id, text, len) ((void)0)
+#endif
+
+#if ZB_LOG_LEVEL >= ZB_LOG_LEVEL_DEBUG
+#define ZB_LOG_DEBUG(...) ZB_LOG_EMIT(__VA_ARGS__)
+#define ZB_LOG_DEBUG_TEXT(id, text, len) ZB_LOG_EMIT_TEXT(id, text, len)
+#else
+#define ZB_LOG_DEBUG(...) ((void)0)
+#define ZB_LOG_DEBUG_TEXT(id, text, len) ((void)0)
+#endif
+
+#endif /* __ZIGBEE_LOG_H__ */
@@ -0,0 +1,66 @@
+/**
+ * Message table shared by the firmware and the host decoder (Host/zigbee_log_decode.c).
+ * The firmware only turns it into message IDs, the format strings never reach flash.
+ *
+ * Formats are printf style: every %d/%u/%x consumes one 32-bit argument of the record,
+ * a %s consumes the text that follows the arguments and must come last.
+ * Append new messages at the end so existing IDs keep their meaning in old captures.
+ */
+ZB_LOG_MSG(ZB_MSG_STARTING,           "Starting...")
+ZB_LOG_MSG(ZB_MSG_RX_LINE,            "rx_buffer: %s")
+ZB_LOG_MSG(ZB_MSG_MBMP_MALFORMED,     "Malformed MBMP bitmap, ignored.")
+ZB_LOG_MSG(ZB_MSG_SLOT_REPLY,         "ID %d is present. Responding in slot %d.")
+ZB_LOG_MSG(ZB_MSG_GET_ID,             "Get ID: %s")
+ZB_LOG_MSG(ZB_MSG_GET_ID_TIMEOUT,     "Get ID timeout, retrying")
+ZB_LOG_MSG(ZB_MSG_GET_ID_OK,          "Get ID OK: %s")
+ZB_LOG_MSG(ZB_MSG_SELF_ID,            "ID: %d")
+ZB_LOG_MSG(ZB_MSG_GET_ID_FAIL,        "Get ID fail: %s")
+ZB_LOG_MSG(ZB_MSG_NETWORK_CHECK,      "Starting Zigbee network check...")
+ZB_LOG_MSG(ZB_MSG_DEV_TIMEOUT,        "Timeout waiting for DEV status, retrying...")
+ZB_LOG_MSG(ZB_MSG_DEV_OK,             "Device type detect OK.")
+ZB_LOG_MSG(ZB_MSG_DEV_NOT_OK,         "Device type detect not OK, retrying...")
+ZB_LOG_MSG(ZB_MSG_NWK_TIMEOUT,        "Timeout waiting for NWK status, retrying...")
+ZB_LOG_MSG(ZB_MSG_NWK_OK,             "Network status OK. Startup complete.")
+ZB_LOG_MSG(ZB_MSG_NWK_NOT_JOINED,     "Not in a network. Attempting to join...")
+ZB_LOG_MSG(ZB_MSG_NWK_OFFLINE,        "Network offline, redetect")
+ZB_LOG_MSG(ZB_MSG_NWK_LEAVE,          "Leave network for rejoin")
+ZB_LOG_MSG(ZB_MSG_NWK_UNEXPECTED,     "Error: Unexpected response to AT+NWK?")
+ZB_LOG_MSG(ZB_MSG_JOIN_TIMEOUT,       "Timeout waiting for JOIN OK, retrying...")
+ZB_LOG_MSG(ZB_MSG_JOIN_OK,            "Join command accepted. Waiting for network connection...")
+ZB_LOG_MSG(ZB_MSG_JOIN_FAIL,          "Error: AT+JOIN command failed.")
+ZB_LOG_MSG(ZB_MSG_EXIT_TIMEOUT,       "Timeout waiting for EXIT OK, retrying...")
+ZB_LOG_MSG(ZB_MSG_EXIT_OK,            "AT+EXIT finish.")
+ZB_LOG_MSG(ZB_MSG_EXIT_FAIL,          "Error: AT+EXIT command failed.")
+ZB_LOG_MSG(ZB_MSG_ADDR_TIMEOUT,       "Timeout waiting for ADDR, retrying...")
+ZB_LOG_MSG(ZB_MSG_ADDR,               "ADDR: %s")
+ZB_LOG_MSG(ZB_MSG_ADDR_FAIL,          "Error: AT+ADDR command failed.")
+ZB_LOG_MSG(ZB_MSG_DSTADDR_TIMEOUT,    "Timeout setting DSTADDR, retrying...")
+ZB_LOG_MSG(ZB_MSG_DSTADDR_OK,         "AT+DSTADDR command accepted.")
+ZB_LOG_MSG(ZB_MSG_DSTADDR_FAIL,       "Error: AT+DSTADDR command failed.")
+ZB_LOG_MSG(ZB_MSG_DSTEP_TIMEOUT,      "Timeout setting DSTEP, retrying...")
+ZB_LOG_MSG(ZB_MSG_DSTEP_OK,           "AT+DSTEP command accepted.")
+ZB_LOG_MSG(ZB_MSG_DSTEP_FAIL,         "Error: AT+DSTEP command failed.")
+ZB_LOG_MSG(ZB_MSG_CH_TIMEOUT,         "Timeout setting CH, retrying...")
+ZB_LOG_MSG(ZB_MSG_CH_OK,              "AT+CH command accepted.")
+ZB_LOG_MSG(ZB_MSG_CH_FAIL,            "Error: AT+CH command failed.")
+ZB_LOG_MSG(ZB_MSG_STARTUP_PHASE,      "Startup step %d took %u ms")
+ZB_LOG_MSG(ZB_MSG_STARTUP_TIME,       "Startup complete %u ms after reset")
+ZB_LOG_MSG(ZB_MSG_WARM_BOOT,          "Saved network parameters confirmed, startup shortened.")
+ZB_LOG_MSG(ZB_MSG_STORE_STALE,        "Saved network parameters out of date, full startup.")
+ZB_LOG_MSG(ZB_MSG_STORE_FAILED,       "Error: saving network parameters failed.")
+ZB_LOG_MSG(ZB_MSG_REJOIN_BACKOFF,     "Rejoin attempt %d in %u ms")
+ZB_LOG_MSG(ZB_MSG_POWER_STATS,        "Power: awake %u ms, asleep %u ms, %u sleeps, %u stops")
+ZB_LOG_MSG(ZB_MSG_POWER_WAKE,         "Stop wake-up took %u us, at most %u us")
+ZB_LOG_MSG(ZB_MSG_BAUD,               "Zigbee link at %u baud")
+ZB_LOG_MSG(ZB_MSG_BAUD_PROBE,         "No answer, probing the module at %u baud")
+ZB_LOG_MSG(ZB_MSG_BAUD_TIMEOUT,       "Timeout waiting for AT+BAUD response.")
+ZB_LOG_MSG(ZB_MSG_BAUD_FAIL,          "Error: AT+BAUD command failed.")
+ZB_LOG_MSG(ZB_MSG_BAUD_FALLBACK,      "Error: link failed at %u baud, back to %u baud")
+ZB_LOG_MSG(ZB_MSG_RX_FRAME,           "rx_frame: type %d, %d bytes")
+ZB_LOG_MSG(ZB_MSG_REPLY_BATCH,        "Reply frame of %d bytes, %d records queued")
+ZB_LOG_MSG(ZB_MSG_GET_ID_RECHECK,     "No ID from the coordinator, checking network and address again")
+ZB_LOG_MSG(ZB_MSG_PROF_REGION,        "Profile: min %u avg %u max %u cycles over %u runs, %s")
+ZB_LOG_MSG(ZB_MSG_CONSOLE_UNKNOWN,    "Unknown console command '%s'")
+ZB_LOG_MSG(ZB_MSG_LATENCY_TOTALS,     "Reply latency (slot timer to DMA start): %u replies, late by %u us on average, %u us at most, %u early")
+ZB_LOG_MSG(ZB_MSG_LATENCY_BUCKET,     "Reply latency from %u us: %u replies")
+ZB_LOG_MSG(ZB_MSG_RX_OVERFLOW,        "RX line queue full: %u lines dropped, %u since reset")
@@ -0,0 +1,24 @@
+#ifndef __ZIGBEE_REPLY_H__
+#define __ZIGBEE_REPLY_H__
+
+#include "main.h"
+#include "mbmp.h"
+#include <stdbool.h>
+
+// Payload of an MBMP_FRAME_REPLY frame: [ID low][ID high][sequence][record count], then
+// each record as [length][bytes]. The sequence number goes up by one per frame sent, so
+// the master can tell a lost reply from an empty one.
+#define ZIGBEE_REPLY_HEADER_LEN 4
+#define ZIGBEE_REPLY_MAX_FRAME 64 // Longest reply, one packet of the module's transparent mode
+#define ZIGBEE_REPLY_RECORD_MAX (ZIGBEE_REPLY_MAX_FRAME - MBMP_FRAME_OVERHEAD - ZIGBEE_REPLY_HEADER_LEN - 1)
+
+// Records the firmware can queue itself, told apart by their first byte
+#define ZIGBEE_RECORD_POWER 0x01 // LOW_POWER_REPLY_RECORDS builds: awake ms, sleep ms, sleeps, stops,
+                                 // each 32-bit little endian
+
+bool zigbee_reply_push(const uint8_t *data, uint8_t len);
+uint16_t zigbee_reply_pending(void);
+uint16_t zigbee_reply_build(uint16_t id, uint16_t max_len, uint8_t *frame);
+void zigbee_reply_commit(void);
+
+#endif /* __ZIGBEE_REPLY_H__ */
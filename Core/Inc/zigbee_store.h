@@ -0,0 +1,20 @@
+#ifndef __ZIGBEE_STORE_H__
+#define __ZIGBEE_STORE_H__
+
+#include "main.h"
+#include <stdbool.h>
+
+// What a warm boot needs to skip the startup handshake
+typedef struct {
+    uint32_t config_hash; // Hash of the module configuration the record was taken under
+    uint8_t addr[16];     // GETID request holding our short address, see zigbee_info.zigbee_addr
+    uint8_t id[4];        // ID assigned by the master, null-terminated unless all 4 digits are used
+} ZigbeeStoreData_t;
+
+bool zigbee_store_load(ZigbeeStoreData_t *data);
+bool zigbee_store_save(const ZigbeeStoreData_t *data);
+uint32_t zigbee_store_hash(const void *data, uint32_t len, uint32_t hash);
+
+#define ZIGBEE_STORE_HASH_INIT 0x811C9DC5u
+
+#endif /* __ZIGBEE_STORE_H__ */
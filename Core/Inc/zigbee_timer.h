@@ -0,0 +1,15 @@
+#ifndef __ZIGBEE_TIMER_H__
+#define __ZIGBEE_TIMER_H__
+
+#include "tim.h"
+#include <stdbool.h>
+
+typedef void (*ZigbeeTimerCallback_t)(void);
+
+void zigbee_timer_start(void);
+uint32_t zigbee_timer_now_us(void);
+void zigbee_timer_schedule_at(uint32_t deadline_us, ZigbeeTimerCallback_t callback);
+void zigbee_timer_cancel(void);
+bool zigbee_timer_armed(void);
+
+#endif /* __ZIGBEE_TIMER_H__ */
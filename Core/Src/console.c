@@ -0,0 +1,101 @@
+#include "console.h"
+#include "scheduler.h"
+#include "usart.h"
+#include "zigbee_log.h"
+
+#define CONSOLE_RX_MASK (CONSOLE_RX_DEPTH - 1)
+
+typedef struct {
+    char command;
+    ConsoleHandler_t handler;
+} ConsoleCommand_t;
+
+static ConsoleCommand_t console_commands[CONSOLE_COMMAND_MAX];
+static uint8_t console_command_count = 0;
+
+static uint8_t console_rx_byte;                  // Written by the UART interrupt
+static uint8_t console_rx_queue[CONSOLE_RX_DEPTH];
+static volatile uint8_t console_rx_head = 0;     // Written by the RX interrupt only
+static volatile uint8_t console_rx_tail = 0;     // Written by the main loop only
+
+void HAL_UART_RxCpltCallback(UART_HandleTypeDef *huart);
+
+/**
+ * @brief Runs the handler of every character received since the last call.
+ */
+static void console_on_event(void)
+{
+    while (console_rx_tail != console_rx_head) {
+        char command = (char)console_rx_queue[console_rx_tail & CONSOLE_RX_MASK];
+        bool known = false;
+
+        console_rx_tail++;
+        if (command == '\r' || command == '\n' || command == ' ') {
+            continue; // Terminal line endings
+        }
+        for (uint8_t i = 0; i < console_command_count; i++) {
+            if (console_commands[i].command == command) {
+                console_commands[i].handler();
+                known = true;
+            }
+        }
+        if (!known) {
+            ZB_LOG_WARN_TEXT(ZB_MSG_CONSOLE_UNKNOWN, &command, 1);
+        }
+    }
+}
+
+/**
+ * @brief Starts receiving commands on USART2. Call it after MX_USART2_UART_Init().
+ */
+void console_init(void)
+{
+    console_rx_head = 0;
+    console_rx_tail = 0;
+    scheduler_subscribe(SCHED_EVENT_CONSOLE, console_on_event);
+    HAL_UART_Receive_IT(&huart2, &console_rx_byte, 1);
+}
+
+/**
+ * @brief Adds a command. Handlers registered for the same character all run, in order.
+ * @param command The character that runs it.
+ * @param handler Run from the main loop when the character is received.
+ * @return false if CONSOLE_COMMAND_MAX commands are registered already.
+ */
+bool console_register(char command, ConsoleHandler_t handler)
+{
+    if (console_command_count >= CONSOLE_COMMAND_MAX) {
+        return false;
+    }
+    console_commands[console_command_count].command = command;
+    console_commands[console_command_count].handler = handler;
+    console_command_count++;
+    return true;
+}
+
+/**
+ * @brief Restarts the reception after an overrun stopped it. Called by HAL_UART_ErrorCallback().
+ */
+void console_rx_error(void)
+{
+    HAL_UART_Receive_IT(&huart2, &console_rx_byte, 1);
+}
+
+/**
+ * @brief Called by the HAL when the character has been received.
+ * @param huart The UART handle.
+ */
+void HAL_UART_RxCpltCallback(UART_HandleTypeDef *huart)
+{
+    if (huart->Instance == USART2) {
+        uint8_t head = console_rx_head;
+
+        // Characters typed faster than the main loop runs them are dropped
+        if ((uint8_t)(head - console_rx_tail) < CONSOLE_RX_DEPTH) {
+            console_rx_queue[head & CONSOLE_RX_MASK] = console_rx_byte;
+            console_rx_head = head + 1;
+            scheduler_post(SCHED_EVENT_CONSOLE);
+        }
+        HAL_UART_Receive_IT(&huart2, &console_rx_byte, 1);
+    }
+}
@@ -0,0 +1,90 @@
+#include "latency.h"
+#include "console.h"
+#include "zigbee_log.h"
+#include <string.h>
+
+static LatencyStats_t latency;
+
+/**
+ * @brief Clears the histogram and adds the console commands: 'h' logs it, 'c' clears it.
+ *        It measures the slot timer against its own deadline, see latency.h.
+ *        Call it after console_init().
+ */
+void latency_init(void)
+{
+    latency_clear();
+    console_register('h', latency_report);
+    console_register('c', latency_clear);
+}
+
+/**
+ * @brief Adds one reply. Called from the TIM2 interrupt once the reply is handed to the DMA.
+ * @param late_us Microseconds from the start of the slot to the DMA hand-off, negative if early.
+ */
+void latency_record(int32_t late_us)
+{
+    uint32_t primask = __get_PRIMASK();
+
+    __disable_irq();
+    if (late_us < 0) {
+        latency.early++;
+    } else {
+        uint32_t value = (uint32_t)late_us;
+        uint8_t bucket = 0;
+
+        while (value != 0 && bucket < LATENCY_BUCKETS - 1) {
+            value >>= 1;
+            bucket++;
+        }
+        latency.buckets[bucket]++;
+        latency.total_us += (uint32_t)late_us;
+        if ((uint32_t)late_us > latency.max_us) {
+            latency.max_us = (uint32_t)late_us;
+        }
+    }
+    latency.count++;
+    __set_PRIMASK(primask);
+}
+
+/**
+ * @brief Returns the histogram, it keeps changing while replies go out.
+ */
+const LatencyStats_t *latency_stats(void)
+{
+    return &latency;
+}
+
+/**
+ * @brief Logs the totals, then one record per bucket that is not empty, at the INFO level.
+ */
+void latency_report(void)
+{
+#if ZB_LOG_LEVEL >= ZB_LOG_LEVEL_INFO
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    LatencyStats_t stats = latency;
+    __set_PRIMASK(primask);
+
+    uint32_t late = stats.count - stats.early;
+    ZB_LOG_INFO(ZB_MSG_LATENCY_TOTALS, stats.count, (late != 0) ? stats.total_us / late : 0, stats.max_us,
+                stats.early);
+
+    for (uint8_t bucket = 0; bucket < LATENCY_BUCKETS; bucket++) {
+        if (stats.buckets[bucket] != 0) {
+            ZB_LOG_INFO(ZB_MSG_LATENCY_BUCKET, (bucket == 0) ? 0 : 1u << (bucket - 1), stats.buckets[bucket]);
+        }
+    }
+#endif
+}
+
+/**
+ * @brief Starts the counting over.
+ */
+void latency_clear(void)
+{
+    uint32_t primask = __get_PRIMASK();
+
+    __disable_irq();
+    memset(&latency, 0, sizeof(latency));
+    __set_PRIMASK(primask);
+}
@@ -0,0 +1,174 @@
+#include "low_power.h"
+#include "scheduler.h"
+#include "uart_tx.h"
+#include "zigbee_log.h"
+#include "zigbee_timer.h"
+#if LOW_POWER_REPLY_RECORDS
+#include "zigbee_reply.h"
+#endif
+
+#define LOW_POWER_WAKE_PIN GPIO_PIN_7 // USART1 RX on PB7 (remapped), its start bit ends Stop mode
+
+void SystemClock_Config(void);
+
+static LowPowerStats_t lp_stats;
+static uint32_t lp_last_us = 0;       // When the CPU last woke up
+static uint32_t lp_tick_debt_us = 0;  // Sleep time not yet added to the HAL tick
+static uint64_t lp_report_mark_us = 0;
+
+#if LOW_POWER_REPLY_RECORDS
+/**
+ * @brief Writes a value into a record, little endian.
+ */
+static uint8_t *low_power_put32(uint8_t *record, uint32_t value)
+{
+    record[0] = (uint8_t)value;
+    record[1] = (uint8_t)(value >> 8);
+    record[2] = (uint8_t)(value >> 16);
+    record[3] = (uint8_t)(value >> 24);
+    return record + 4;
+}
+
+/**
+ * @brief Queues the accounting counters for the master with the next replies.
+ */
+static void low_power_push_record(void)
+{
+    uint8_t record[1 + 4 * 4];
+    uint8_t *pos = record;
+
+    *pos++ = ZIGBEE_RECORD_POWER;
+    pos = low_power_put32(pos, (uint32_t)(lp_stats.awake_us / 1000));
+    pos = low_power_put32(pos, (uint32_t)(lp_stats.sleep_us / 1000));
+    pos = low_power_put32(pos, lp_stats.sleep_count);
+    low_power_put32(pos, lp_stats.stop_count);
+    zigbee_reply_push(record, sizeof(record)); // A node nobody polls keeps the older reports
+}
+#endif
+
+/**
+ * @brief Logs the accounting counters, and queues them for the master if
+ *        LOW_POWER_REPLY_RECORDS is set.
+ */
+static void low_power_report(void)
+{
+    ZB_LOG_INFO(ZB_MSG_POWER_STATS, (int32_t)(lp_stats.awake_us / 1000), (int32_t)(lp_stats.sleep_us / 1000),
+                (int32_t)lp_stats.sleep_count, (int32_t)lp_stats.stop_count);
+#if LOW_POWER_REPLY_RECORDS
+    low_power_push_record();
+#endif
+    if (lp_stats.stop_count != 0) {
+        ZB_LOG_INFO(ZB_MSG_POWER_WAKE, (int32_t)lp_stats.wake_last_us, (int32_t)lp_stats.wake_max_us);
+    }
+}
+
+/**
+ * @brief Prepares the wake-up sources and starts the accounting. Call it after
+ *        zigbee_timer_start().
+ */
+void low_power_init(void)
+{
+    // The cycle counter times the Stop wake-up, it counts without a debugger attached
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CYCCNT = 0;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+
+#if LOW_POWER_ALLOW_STOP
+    // EXTI7 watches the RX pin for a falling edge while the pin stays a USART input. It is
+    // only unmasked around Stop mode; any other unmasked EXTI line wakes the node as well.
+    __HAL_RCC_AFIO_CLK_ENABLE();
+    AFIO->EXTICR[1] = (AFIO->EXTICR[1] & ~AFIO_EXTICR2_EXTI7) | AFIO_EXTICR2_EXTI7_PB;
+    EXTI->RTSR &= ~LOW_POWER_WAKE_PIN;
+    EXTI->FTSR |= LOW_POWER_WAKE_PIN;
+    EXTI->IMR &= ~LOW_POWER_WAKE_PIN;
+    HAL_NVIC_SetPriority(EXTI9_5_IRQn, 0, 0);
+    HAL_NVIC_EnableIRQ(EXTI9_5_IRQn);
+#endif
+
+    lp_last_us = zigbee_timer_now_us();
+    scheduler_subscribe(SCHED_EVENT_POWER_REPORT, low_power_report);
+}
+
+#if LOW_POWER_ALLOW_STOP
+/**
+ * @brief Stops every clock until the RX start bit or another EXTI line, then brings the
+ *        PLL back. Interrupts are masked, the wake-up one runs once they are unmasked.
+ */
+static void low_power_stop(void)
+{
+    __HAL_GPIO_EXTI_CLEAR_IT(LOW_POWER_WAKE_PIN);
+    EXTI->IMR |= LOW_POWER_WAKE_PIN;
+    HAL_SuspendTick();
+
+    HAL_PWR_EnterSTOPMode(PWR_LOWPOWERREGULATOR_ON, PWR_STOPENTRY_WFI);
+
+    // Woken on the HSI at 8 MHz, the rest of the clock tree must be set up again
+    uint32_t wake_cycles = DWT->CYCCNT;
+    SystemClock_Config();
+    HAL_ResumeTick();
+    EXTI->IMR &= ~LOW_POWER_WAKE_PIN;
+
+    // Counted mostly at 8 MHz, the PLL takes over only at the end
+    uint32_t wake_us = (DWT->CYCCNT - wake_cycles) / (HSI_VALUE / 1000000u);
+    lp_stats.stop_count++;
+    lp_stats.wake_last_us = wake_us;
+    if (wake_us > lp_stats.wake_max_us) {
+        lp_stats.wake_max_us = wake_us;
+    }
+}
+#endif
+
+/**
+ * @brief Sleeps until the next interrupt in the deepest mode the pending work allows.
+ *        Called by scheduler_dispatch() with interrupts masked when no event is pending.
+ */
+void low_power_idle(void)
+{
+    uint32_t sleep_start_us = zigbee_timer_now_us();
+    bool timers = scheduler_timers_active();
+
+    lp_stats.awake_us += sleep_start_us - lp_last_us;
+    if (LOW_POWER_REPORT_MS != 0 &&
+        lp_stats.awake_us + lp_stats.sleep_us - lp_report_mark_us >= LOW_POWER_REPORT_MS * 1000ull) {
+        lp_report_mark_us = lp_stats.awake_us + lp_stats.sleep_us;
+        scheduler_post(SCHED_EVENT_POWER_REPORT); // Seen on the next dispatch, after this sleep
+    }
+
+#if LOW_POWER_ALLOW_STOP
+    if (!timers && !zigbee_timer_armed() && uart_tx_idle()) {
+        // The HAL tick and the microsecond clock both stand still until the wake-up
+        low_power_stop();
+        lp_last_us = zigbee_timer_now_us();
+        return;
+    }
+#endif
+
+    // With no timer on the wheel the 1 ms tick only wakes us for nothing. TIM2 keeps
+    // running and overflows every 65 ms at the latest, the HAL tick catches up from it.
+    if (!timers) {
+        HAL_SuspendTick();
+    }
+
+    HAL_PWR_EnterSLEEPMode(PWR_MAINREGULATOR_ON, PWR_SLEEPENTRY_WFI);
+
+    uint32_t wake_us = zigbee_timer_now_us();
+    uint32_t slept_us = wake_us - sleep_start_us;
+    if (!timers) {
+        lp_tick_debt_us += slept_us;
+        uwTick += lp_tick_debt_us / 1000;
+        lp_tick_debt_us %= 1000;
+        HAL_ResumeTick();
+    }
+
+    lp_stats.sleep_count++;
+    lp_stats.sleep_us += slept_us;
+    lp_last_us = wake_us;
+}
+
+/**
+ * @brief Returns the accounting counters.
+ */
+const LowPowerStats_t *low_power_stats(void)
+{
+    return &lp_stats;
+}
@@ -18,11 +18,20 @@
 /* USER CODE END Header */
 /* Includes ------------------------------------------------------------------*/
 #include "main.h"
+#include "dma.h"
+#include "tim.h"
 #include "usart.h"
 #include "gpio.h"
 
 /* Private includes ----------------------------------------------------------*/
 /* USER CODE BEGIN Includes */
+#include "zigbee_uart_handle.h"
+#include "zigbee_timer.h"
+#include "scheduler.h"
+#include "low_power.h"
+#include "console.h"
+#include "profiler.h"
+#include "latency.h"
 
 /* USER CODE END Includes */
 
@@ -87,10 +96,18 @@ int main(void)
 
   /* Initialize all configured peripherals */
   MX_GPIO_Init();
+  MX_DMA_Init();
   MX_USART1_UART_Init();
   MX_USART2_UART_Init();
+  MX_TIM2_Init();
   /* USER CODE BEGIN 2 */
 
+  uart_tx_init();
+  console_init();
+  profiler_init();
+  latency_init();
+  zigbee_timer_start();
+  low_power_init();
   zigbee_init();
   /* USER CODE END 2 */
 
@@ -103,8 +120,7 @@ int main(void)
     /* USER CODE END WHILE */
 
     /* USER CODE BEGIN 3 */
-    // U2_printf("led toggle aa\r\n");
-    zigbee_run();
+    scheduler_dispatch(); // Runs pending events, sleeps or stops until the next interrupt otherwise
     
   }
   /* USER CODE END 3 */
@@ -0,0 +1,498 @@
+#include "mbmp.h"
+#include <stdbool.h>
+#include <string.h>
+
+/**
+ * @brief Maps every byte to its hex digit value (0-15).
+ *        Anything that is not '0'-'9', 'a'-'f' or 'A'-'F' maps to MBMP_HEX_INVALID,
+ *        which has a bit no valid digit uses, so validity can be checked once per bitmap.
+ */
+const uint8_t mbmp_hex_lut[256] = {
+    0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10,
+    0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10,
+    0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10,
+    0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10,
+    0x10, 0x0A, 0x0B, 0x0C, 0x0D, 0x0E, 0x0F, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10,
+    0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10,
+    0x10, 0x0A, 0x0B, 0x0C, 0x0D, 0x0E, 0x0F, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10,
+    0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10,
+    0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10,
+    0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10,
+    0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10,
+    0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10,
+    0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10,
+    0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10,
+    0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10,
+    0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10,};
+
+// CRC-8, polynomial 0x07, initial value 0, one table step per frame byte
+static const uint8_t mbmp_crc8_table[256] = {
+    0x00, 0x07, 0x0E, 0x09, 0x1C, 0x1B, 0x12, 0x15, 0x38, 0x3F, 0x36, 0x31, 0x24, 0x23, 0x2A, 0x2D,
+    0x70, 0x77, 0x7E, 0x79, 0x6C, 0x6B, 0x62, 0x65, 0x48, 0x4F, 0x46, 0x41, 0x54, 0x53, 0x5A, 0x5D,
+    0xE0, 0xE7, 0xEE, 0xE9, 0xFC, 0xFB, 0xF2, 0xF5, 0xD8, 0xDF, 0xD6, 0xD1, 0xC4, 0xC3, 0xCA, 0xCD,
+    0x90, 0x97, 0x9E, 0x99, 0x8C, 0x8B, 0x82, 0x85, 0xA8, 0xAF, 0xA6, 0xA1, 0xB4, 0xB3, 0xBA, 0xBD,
+    0xC7, 0xC0, 0xC9, 0xCE, 0xDB, 0xDC, 0xD5, 0xD2, 0xFF, 0xF8, 0xF1, 0xF6, 0xE3, 0xE4, 0xED, 0xEA,
+    0xB7, 0xB0, 0xB9, 0xBE, 0xAB, 0xAC, 0xA5, 0xA2, 0x8F, 0x88, 0x81, 0x86, 0x93, 0x94, 0x9D, 0x9A,
+    0x27, 0x20, 0x29, 0x2E, 0x3B, 0x3C, 0x35, 0x32, 0x1F, 0x18, 0x11, 0x16, 0x03, 0x04, 0x0D, 0x0A,
+    0x57, 0x50, 0x59, 0x5E, 0x4B, 0x4C, 0x45, 0x42, 0x6F, 0x68, 0x61, 0x66, 0x73, 0x74, 0x7D, 0x7A,
+    0x89, 0x8E, 0x87, 0x80, 0x95, 0x92, 0x9B, 0x9C, 0xB1, 0xB6, 0xBF, 0xB8, 0xAD, 0xAA, 0xA3, 0xA4,
+    0xF9, 0xFE, 0xF7, 0xF0, 0xE5, 0xE2, 0xEB, 0xEC, 0xC1, 0xC6, 0xCF, 0xC8, 0xDD, 0xDA, 0xD3, 0xD4,
+    0x69, 0x6E, 0x67, 0x60, 0x75, 0x72, 0x7B, 0x7C, 0x51, 0x56, 0x5F, 0x58, 0x4D, 0x4A, 0x43, 0x44,
+    0x19, 0x1E, 0x17, 0x10, 0x05, 0x02, 0x0B, 0x0C, 0x21, 0x26, 0x2F, 0x28, 0x3D, 0x3A, 0x33, 0x34,
+    0x4E, 0x49, 0x40, 0x47, 0x52, 0x55, 0x5C, 0x5B, 0x76, 0x71, 0x78, 0x7F, 0x6A, 0x6D, 0x64, 0x63,
+    0x3E, 0x39, 0x30, 0x37, 0x22, 0x25, 0x2C, 0x2B, 0x06, 0x01, 0x08, 0x0F, 0x1A, 0x1D, 0x14, 0x13,
+    0xAE, 0xA9, 0xA0, 0xA7, 0xB2, 0xB5, 0xBC, 0xBB, 0x96, 0x91, 0x98, 0x9F, 0x8A, 0x8D, 0x84, 0x83,
+    0xDE, 0xD9, 0xD0, 0xD7, 0xC2, 0xC5, 0xCC, 0xCB, 0xE6, 0xE1, 0xE8, 0xEF, 0xFA, 0xFD, 0xF4, 0xF3,
+};
+
+static const uint8_t mbmp_prefix[] = "MBMP:";
+#define MBMP_PREFIX_LEN (sizeof(mbmp_prefix) - 1)
+
+/**
+ * @brief Counts the set bits of a 32-bit word (SWAR, the Cortex-M3 has no popcount instruction).
+ * @param v The word.
+ * @return The number of set bits.
+ */
+static uint32_t mbmp_popcount32(uint32_t v)
+{
+    v = v - ((v >> 1) & 0x55555555u);
+    v = (v & 0x33333333u) + ((v >> 2) & 0x33333333u);
+    v = (v + (v >> 4)) & 0x0F0F0F0Fu;
+    return (v * 0x01010101u) >> 24;
+}
+
+#if MBMP_WHOLE_POLL
+/**
+ * @brief Decodes the hex payload of an MBMP poll into a binary bitmap.
+ *        The payload is read in place (e.g. straight from the RX line) with a known
+ *        length; the bitmap is not cleared, only the returned number of bytes is valid.
+ * @param hex The hex characters (e.g., "a813"), not null-terminated.
+ * @param hex_len The number of characters in hex.
+ * @param bitmap The output byte array to store the binary bitmap.
+ * @param max_bitmap_size The size of the output bitmap buffer.
+ * @return The number of bytes written to the bitmap, or -1 if the payload is empty,
+ *         has an odd length, does not fit in the bitmap or contains a non-hex character.
+ */
+int mbmp_decode_hex(const uint8_t *hex, uint16_t hex_len, uint8_t *bitmap, uint16_t max_bitmap_size)
+{
+    uint16_t byte_count = hex_len / 2;
+    uint8_t invalid = 0;
+
+    if (hex_len == 0 || (hex_len & 1) || byte_count > max_bitmap_size) {
+        return -1;
+    }
+
+    // No per-character branches: collect the invalid marker and test it once at the end
+    for (uint16_t i = 0; i < byte_count; i++) {
+        uint8_t high_nibble = mbmp_hex_lut[hex[2 * i]];
+        uint8_t low_nibble = mbmp_hex_lut[hex[2 * i + 1]];
+
+        invalid |= high_nibble | low_nibble;
+        bitmap[i] = (uint8_t)((high_nibble << 4) | (low_nibble & 0x0F));
+    }
+
+    if (invalid & MBMP_HEX_INVALID) {
+        return -1;
+    }
+    return byte_count;
+}
+
+/**
+ * @brief Checks if a device should respond and calculates its time slot.
+ *        Bit (id - 1) of the bitmap, LSB first in each byte, marks slave id as polled.
+ *        The slot is the number of polled slaves with a lower ID, counted a whole
+ *        32-bit word at a time with the last partial word masked below our own bit.
+ *
+ * @param bitmap The decoded bitmap from the master.
+ * @param max_bit The highest possible ID number represented in the bitmap.
+ * @param self_id The ID of this device.
+ * @return The time slot (0 for first, 1 for second, etc.), or -1 if the device should not respond.
+ */
+int mbmp_get_response_slot(const uint8_t *bitmap, int max_bit, int self_id)
+{
+    if (self_id <= 0 || self_id > max_bit) {
+        return -1;
+    }
+
+    // 1. First, check if our own ID is present in the bitmap.
+    uint16_t self_byte_index = (uint16_t)(self_id - 1) >> 3;
+    uint8_t self_mask = (uint8_t)(1u << ((self_id - 1) & 7));
+    if (!(bitmap[self_byte_index] & self_mask)) {
+        return -1; // Our bit is not set, we should not respond.
+    }
+
+    // 2. Count the devices with a LOWER ID, four bitmap bytes per step.
+    uint32_t preceding_slaves = 0;
+    uint16_t i = 0;
+    for (; i + 4 <= self_byte_index; i += 4) {
+        uint32_t word;
+        memcpy(&word, &bitmap[i], sizeof(word)); // The bitmap need not be word aligned
+        preceding_slaves += mbmp_popcount32(word);
+    }
+
+    // 3. The remaining whole bytes and the bits below ours in our own byte form the last word.
+    uint32_t tail = bitmap[self_byte_index] & (uint8_t)(self_mask - 1);
+    for (; i < self_byte_index; i++) {
+        tail = (tail << 8) | bitmap[i];
+    }
+    preceding_slaves += mbmp_popcount32(tail);
+
+    return (int)preceding_slaves;
+}
+#endif /* MBMP_WHOLE_POLL */
+
+#if MBMP_WHOLE_POLL
+/**
+ * @brief Reads entry i of an MBMP_FRAME_IDS payload.
+ */
+static uint16_t mbmp_id_entry(const uint8_t *entries, uint16_t i)
+{
+    return (uint16_t)(entries[2 * i] | (entries[2 * i + 1] << 8));
+}
+
+/**
+ * @brief Works out the slot from the payload of an MBMP_FRAME_IDS poll.
+ *        Every range before our entry moves our slot by its width, so a search for the
+ *        entry would still have to walk all those before it. One walk does both, and
+ *        stops at the first entry past our ID.
+ *
+ * @param entries The payload, MBMP_FRAME_IDS entries.
+ * @param entries_len The payload length in bytes.
+ * @param self_id The ID of this device.
+ * @return The time slot, -1 if the device should not respond, or -2 if the list is not
+ *         well formed (only checked up to our entry).
+ */
+int mbmp_id_list_get_response_slot(const uint8_t *entries, uint16_t entries_len, int self_id)
+{
+    uint16_t count = entries_len / 2;
+    uint16_t last = 0;
+    int slot = 0;
+
+    if (entries_len & 1) {
+        return -2;
+    }
+    if (self_id <= 0 || self_id > MBMP_ID_MAX) {
+        return -1;
+    }
+
+    for (uint16_t i = 0; i < count; i++) {
+        uint16_t entry = mbmp_id_entry(entries, i);
+        uint16_t first = entry & MBMP_ID_MAX;
+
+        if (first <= last) {
+            return -2; // Zero, out of order or overlapping
+        }
+        last = first;
+        if (entry & MBMP_ID_RANGE) {
+            if (++i >= count || (mbmp_id_entry(entries, i) & MBMP_ID_RANGE)) {
+                return -2;
+            }
+            last = mbmp_id_entry(entries, i);
+            if (last < first) {
+                return -2;
+            }
+        }
+        if ((uint16_t)self_id < first) {
+            return -1; // Between two entries
+        }
+        if ((uint16_t)self_id <= last) {
+            return slot + (self_id - first);
+        }
+        slot += last - first + 1;
+    }
+    return -1;
+}
+#endif /* MBMP_WHOLE_POLL */
+
+/**
+ * @brief Prepares a stream parser for a new line.
+ * @param stream The parser state.
+ * @param self_id The ID of this device, 0 if not known yet (nothing is ever polled then).
+ */
+void mbmp_stream_begin(MbmpStream_t *stream, int self_id)
+{
+    memset(stream, 0, sizeof(*stream));
+    stream->self_polled = -1;
+    stream->run_start = 1;
+    if (self_id > 0 && self_id <= UINT16_MAX) {
+        stream->self_id = (uint16_t)self_id;
+    }
+    if (self_id > 0 && self_id <= MBMP_MAX_BITMAP_SIZE * 8) {
+        stream->self_byte_index = (uint16_t)(self_id - 1) >> 3;
+        stream->self_mask = (uint8_t)(1u << ((self_id - 1) & 7));
+        stream->self_hex_end = (uint16_t)(2 * (stream->self_byte_index + 1));
+    }
+}
+
+/**
+ * @brief Takes one decoded bitmap byte. Bytes before our own are popcounted as they
+ *        complete, so our slot is fixed the moment our byte arrives.
+ */
+static void mbmp_stream_bitmap_byte(MbmpStream_t *stream, uint16_t byte_index, uint8_t byte)
+{
+    if (stream->self_polled >= 0 || stream->self_mask == 0) {
+        return;
+    }
+    if (byte_index < stream->self_byte_index) {
+        stream->preceding_slaves += mbmp_popcount32(byte);
+    } else {
+        stream->preceding_slaves += mbmp_popcount32(byte & (uint8_t)(stream->self_mask - 1));
+        stream->self_polled = (byte & stream->self_mask) ? 1 : 0;
+    }
+}
+
+/**
+ * @brief Takes one run of a run-length frame. Even runs are IDs that are not polled,
+ *        odd runs IDs that are; our slot is fixed by the run that holds our ID.
+ */
+static void mbmp_stream_run(MbmpStream_t *stream, uint16_t run_index, uint8_t run)
+{
+    uint8_t polled = run_index & 1;
+
+    if (stream->self_polled >= 0 || stream->self_id == 0) {
+        return;
+    }
+    if ((uint32_t)stream->run_start + run > stream->self_id) {
+        if (polled) {
+            stream->preceding_slaves += stream->self_id - stream->run_start;
+        }
+        stream->self_polled = (int8_t)polled;
+        return;
+    }
+    if (polled) {
+        stream->preceding_slaves += run;
+    }
+    stream->run_start += run;
+}
+
+/**
+ * @brief Takes the IDs first to last of an ID list frame.
+ */
+static void mbmp_stream_ids(MbmpStream_t *stream, uint16_t first, uint16_t last)
+{
+    if (first <= stream->last_id || last < first) {
+        stream->invalid |= MBMP_HEX_INVALID; // Zero, out of order or overlapping
+        return;
+    }
+    stream->last_id = last;
+
+    if (stream->self_polled >= 0 || stream->self_id == 0) {
+        return;
+    }
+    if (stream->self_id < first) {
+        stream->self_polled = 0; // Sorted list, we were skipped
+    } else if (stream->self_id <= last) {
+        stream->preceding_slaves += stream->self_id - first;
+        stream->self_polled = 1;
+    } else {
+        stream->preceding_slaves += last - first + 1;
+    }
+}
+
+/**
+ * @brief Takes one 16-bit entry of an ID list frame.
+ */
+static void mbmp_stream_id_entry(MbmpStream_t *stream, uint16_t entry)
+{
+    if (stream->range_first != 0) {
+        if (entry & MBMP_ID_RANGE) {
+            stream->invalid |= MBMP_HEX_INVALID;
+        }
+        mbmp_stream_ids(stream, stream->range_first, entry & MBMP_ID_MAX);
+        stream->range_first = 0;
+    } else if (entry & MBMP_ID_RANGE) {
+        stream->range_first = entry & MBMP_ID_MAX;
+        if (stream->range_first == 0) {
+            stream->invalid |= MBMP_HEX_INVALID;
+        }
+    } else {
+        mbmp_stream_ids(stream, entry, entry);
+    }
+}
+
+/**
+ * @brief Consumes one byte of a binary frame, the sync byte excluded.
+ */
+static void mbmp_stream_feed_frame(MbmpStream_t *stream, uint8_t c)
+{
+    uint16_t pos = stream->frame_pos++;
+
+    if (pos == 0) {
+        stream->frame_type = c;
+        if (c != MBMP_FRAME_BITMAP && c != MBMP_FRAME_RUNS && c != MBMP_FRAME_IDS) {
+            stream->invalid |= MBMP_HEX_INVALID;
+        }
+    } else if (pos == 1) {
+        stream->frame_len = c;
+        if (c == 0 || c > MBMP_FRAME_MAX_PAYLOAD ||
+            (stream->frame_type == MBMP_FRAME_BITMAP && c > MBMP_MAX_BITMAP_SIZE) ||
+            (stream->frame_type == MBMP_FRAME_IDS && (c & 1))) {
+            // A length this wrong could swallow the next polls, end the frame right here
+            stream->invalid |= MBMP_HEX_INVALID;
+            stream->frame_len = 0;
+            stream->ended = 1;
+        }
+    } else if (pos < 2u + stream->frame_len) {
+        if (stream->frame_type == MBMP_FRAME_BITMAP) {
+            mbmp_stream_bitmap_byte(stream, pos - 2, c);
+        } else if (stream->frame_type == MBMP_FRAME_RUNS) {
+            mbmp_stream_run(stream, pos - 2, c);
+        } else if ((pos & 1) == 0) {
+            stream->entry_low = c;
+        } else {
+            mbmp_stream_id_entry(stream, (uint16_t)(stream->entry_low | (c << 8)));
+        }
+    } else {
+        if (c != stream->frame_crc || stream->range_first != 0) {
+            stream->invalid |= MBMP_HEX_INVALID;
+        }
+        stream->ended = 1;
+        return;
+    }
+    stream->frame_crc = mbmp_crc8_table[stream->frame_crc ^ c];
+}
+
+/**
+ * @brief Takes the hex word once four bitmap bytes are in it, or once our own byte
+ *        completes it early. Bytes before ours are counted with one SWAR popcount.
+ */
+static void mbmp_stream_hex_word(MbmpStream_t *stream)
+{
+    if (stream->hex_count > 2 * MBMP_MAX_BITMAP_SIZE) {
+        stream->invalid |= MBMP_HEX_INVALID;
+    }
+    if (stream->self_polled < 0 && stream->self_mask != 0) {
+        if (stream->hex_count == stream->self_hex_end) {
+            uint8_t own = (uint8_t)stream->hex_word;
+
+            stream->preceding_slaves += mbmp_popcount32((stream->hex_word & ~0xFFu) |
+                                                        (own & (uint8_t)(stream->self_mask - 1)));
+            stream->self_polled = (own & stream->self_mask) ? 1 : 0;
+        } else {
+            stream->preceding_slaves += mbmp_popcount32(stream->hex_word);
+        }
+    }
+    stream->hex_word = 0;
+}
+
+/**
+ * @brief Consumes one character of the line as soon as it is received.
+ *        A leading MBMP_FRAME_SYNC starts a binary frame instead, whose end
+ *        mbmp_stream_frame_complete() reports.
+ * @param stream The parser state.
+ * @param c The received character (the terminating '\n' of a text line is not fed).
+ */
+void mbmp_stream_feed(MbmpStream_t *stream, uint8_t c)
+{
+    // The hex payload is nearly all of a poll line, so it is tested first
+    if (stream->prefix_matched == MBMP_PREFIX_LEN) {
+        if (stream->ended) {
+            if (c != '\r') {
+                stream->invalid |= MBMP_HEX_INVALID; // Only the line end may follow the payload
+            }
+        } else if (c == '\r') {
+            stream->ended = 1;
+        } else {
+            uint8_t nibble = mbmp_hex_lut[c];
+
+            // No branch on the digit: the invalid marker is collected and tested at the end
+            stream->invalid |= nibble;
+            stream->hex_word = (stream->hex_word << 4) | (nibble & 0x0F);
+            stream->hex_count++;
+            if ((stream->hex_count & 7) == 0 || stream->hex_count == stream->self_hex_end) {
+                mbmp_stream_hex_word(stream);
+            }
+        }
+        return;
+    }
+    if (stream->frame) {
+        if (!stream->ended) {
+            mbmp_stream_feed_frame(stream, c);
+        }
+        return;
+    }
+    if (stream->prefix_matched < MBMP_PREFIX_LEN) {
+        if (c == mbmp_prefix[stream->prefix_matched]) {
+            stream->prefix_matched++;
+        } else if (stream->prefix_matched == 0 && c == MBMP_FRAME_SYNC) {
+            stream->frame = 1;
+        } else {
+            stream->prefix_matched = 0xFF; // Not an MBMP line, ignore the rest
+        }
+    }
+}
+
+/**
+ * @brief Tells whether the line is a binary frame that has been received completely.
+ *        Binary frames are not terminated by '\n', the receiver ends them on this.
+ * @param stream The parser state.
+ * @return 1 if the frame is complete, 0 otherwise.
+ */
+int mbmp_stream_frame_complete(const MbmpStream_t *stream)
+{
+    return stream->frame && stream->ended;
+}
+
+/**
+ * @brief Finishes the line and returns the decision taken while it was received.
+ * @param stream The parser state.
+ * @return The time slot (0 for first, 1 for second, etc.), MBMP_SLOT_NOT_POLLED,
+ *         MBMP_SLOT_NOT_MBMP or MBMP_SLOT_MALFORMED.
+ */
+int mbmp_stream_end(const MbmpStream_t *stream)
+{
+    if (stream->frame) {
+        if (!stream->ended || (stream->invalid & MBMP_HEX_INVALID)) {
+            return MBMP_SLOT_MALFORMED;
+        }
+        return (stream->self_polled == 1) ? stream->preceding_slaves : MBMP_SLOT_NOT_POLLED;
+    }
+    if (stream->prefix_matched != MBMP_PREFIX_LEN) {
+        return MBMP_SLOT_NOT_MBMP;
+    }
+    if (stream->hex_count == 0 || (stream->hex_count & 1) || stream->hex_count > 2 * MBMP_MAX_BITMAP_SIZE ||
+        (stream->invalid & MBMP_HEX_INVALID)) {
+        return MBMP_SLOT_MALFORMED;
+    }
+    if (stream->self_polled != 1) {
+        return MBMP_SLOT_NOT_POLLED; // Our bit is clear or the bitmap is too short to hold it
+    }
+    return stream->preceding_slaves;
+}
+
+/**
+ * @brief Computes a CRC-8 (polynomial 0x07), chainable over several buffers.
+ * @param crc 0 for a new CRC, or the result of the previous call.
+ * @param data The bytes.
+ * @param len The number of bytes.
+ * @return The CRC.
+ */
+uint8_t mbmp_crc8(uint8_t crc, const uint8_t *data, uint16_t len)
+{
+    for (uint16_t i = 0; i < len; i++) {
+        crc = mbmp_crc8_table[crc ^ data[i]];
+    }
+    return crc;
+}
+
+/**
+ * @brief Builds a binary poll frame, for the master side and host tools.
+ * @param type MBMP_FRAME_BITMAP, MBMP_FRAME_RUNS, MBMP_FRAME_IDS or MBMP_FRAME_REPLY.
+ * @param payload The bitmap, the run lengths, the ID list or the reply records.
+ * @param payload_len The payload length, 1 to MBMP_FRAME_MAX_PAYLOAD.
+ * @param frame The output buffer.
+ * @param max_frame_len The size of the output buffer.
+ * @return The frame length, or -1 if the payload does not fit.
+ */
+int mbmp_frame_encode(uint8_t type, const uint8_t *payload, uint16_t payload_len, uint8_t *frame, uint16_t max_frame_len)
+{
+    if (payload_len == 0 || payload_len > MBMP_FRAME_MAX_PAYLOAD || payload_len + MBMP_FRAME_OVERHEAD > max_frame_len) {
+        return -1;
+    }
+    frame[0] = MBMP_FRAME_SYNC;
+    frame[1] = type;
+    frame[2] = (uint8_t)payload_len;
+    memcpy(&frame[3], payload, payload_len);
+    frame[3 + payload_len] = mbmp_crc8(0, &frame[1], (uint16_t)(payload_len + 2));
+    return payload_len + MBMP_FRAME_OVERHEAD;
+}
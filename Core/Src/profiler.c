@@ -0,0 +1,92 @@
+#include "profiler.h"
+#include "console.h"
+#include "zigbee_log.h"
+#include <string.h>
+
+static ProfStats_t prof_stats[PROF_REGION_COUNT];
+
+static const char *const prof_names[PROF_REGION_COUNT] = {
+    [PROF_RX_PARSE] = "rx parse",
+    [PROF_SLOT_SCHEDULE] = "slot schedule",
+    [PROF_SLOT_TX] = "slot tx",
+    [PROF_ZIGBEE_RUN] = "zigbee run",
+    [PROF_LOG_WRITE] = "log write",
+};
+
+/**
+ * @brief Starts the cycle counter and adds the console commands: 'p' logs the table,
+ *        'c' clears it. Call it after console_init().
+ */
+void profiler_init(void)
+{
+    // Counts without a debugger attached; low_power_init() relies on it as well
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+
+    profiler_clear();
+    console_register('p', profiler_report);
+    console_register('c', profiler_clear);
+}
+
+/**
+ * @brief Adds one run of a region. Safe from interrupts, use PROF_END() rather than this.
+ * @param region The region.
+ * @param cycles Cycles it took.
+ */
+void profiler_record(ProfRegion_t region, uint32_t cycles)
+{
+    ProfStats_t *stats = &prof_stats[region];
+    uint32_t primask = __get_PRIMASK();
+
+    __disable_irq();
+    if (stats->count == 0 || cycles < stats->min) {
+        stats->min = cycles;
+    }
+    if (cycles > stats->max) {
+        stats->max = cycles;
+    }
+    stats->total += cycles;
+    stats->count++;
+    __set_PRIMASK(primask);
+}
+
+/**
+ * @brief Returns the counters of a region, they keep changing while regions run.
+ */
+const ProfStats_t *profiler_stats(ProfRegion_t region)
+{
+    return &prof_stats[region];
+}
+
+/**
+ * @brief Logs one record per region, the regions that never ran included, at the INFO level.
+ */
+void profiler_report(void)
+{
+#if ZB_LOG_LEVEL >= ZB_LOG_LEVEL_INFO
+    for (uint8_t region = 0; region < PROF_REGION_COUNT; region++) {
+        uint32_t primask = __get_PRIMASK();
+        __disable_irq();
+        ProfStats_t stats = prof_stats[region];
+        __set_PRIMASK(primask);
+
+        int32_t args[] = { (int32_t)stats.min,
+                           (int32_t)((stats.count != 0) ? stats.total / stats.count : 0),
+                           (int32_t)stats.max, (int32_t)stats.count };
+        zigbee_log_write(ZB_MSG_PROF_REGION, args, sizeof(args) / sizeof(args[0]),
+                         (const uint8_t *)prof_names[region], (uint16_t)strlen(prof_names[region]));
+    }
+#endif
+}
+
+/**
+ * @brief Starts the counting over.
+ */
+void profiler_clear(void)
+{
+    uint32_t primask = __get_PRIMASK();
+
+    __disable_irq();
+    memset(prof_stats, 0, sizeof(prof_stats));
+    __set_PRIMASK(primask);
+}
@@ -0,0 +1,144 @@
+#include "scheduler.h"
+#include "low_power.h"
+
+#define SCHED_WHEEL_SLOTS 32 // Must be a power of two, one slot per SysTick millisecond
+#define SCHED_WHEEL_MASK (SCHED_WHEEL_SLOTS - 1)
+
+static volatile uint32_t sched_pending = 0; // One bit per SchedEvent_t
+static SchedHandler_t sched_handlers[SCHED_EVENT_COUNT];
+
+// Hashed timer wheel: a timer due in n ticks sits in slot (cursor + n) and is skipped
+// (n - 1) / SCHED_WHEEL_SLOTS times before it fires.
+static SchedTimer_t *sched_wheel[SCHED_WHEEL_SLOTS];
+static uint8_t sched_cursor = 0;
+
+/**
+ * @brief Sets the handler run, in thread mode, when an event is dispatched.
+ * @param event The event.
+ * @param handler The handler, NULL to ignore the event.
+ */
+void scheduler_subscribe(SchedEvent_t event, SchedHandler_t handler)
+{
+    sched_handlers[event] = handler;
+}
+
+/**
+ * @brief Marks an event pending. Safe from interrupts.
+ * @param event The event.
+ */
+void scheduler_post(SchedEvent_t event)
+{
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    sched_pending |= 1u << event;
+    __set_PRIMASK(primask);
+}
+
+static void scheduler_timer_unlink(SchedTimer_t *timer)
+{
+    for (SchedTimer_t **link = &sched_wheel[0]; link < &sched_wheel[SCHED_WHEEL_SLOTS]; link++) {
+        for (SchedTimer_t **entry = link; *entry != NULL; entry = &(*entry)->next) {
+            if (*entry == timer) {
+                *entry = timer->next;
+                timer->active = false;
+                return;
+            }
+        }
+    }
+}
+
+/**
+ * @brief Starts, or restarts, a one-shot timer.
+ * @param timer The timer.
+ * @param delay_ms Time until it posts its event, at least 1 ms.
+ * @param event The event to post.
+ */
+void scheduler_timer_start(SchedTimer_t *timer, uint32_t delay_ms, SchedEvent_t event)
+{
+    if (delay_ms == 0) {
+        delay_ms = 1;
+    }
+
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    if (timer->active) {
+        scheduler_timer_unlink(timer);
+    }
+    uint8_t slot = (uint8_t)((sched_cursor + delay_ms) & SCHED_WHEEL_MASK);
+    timer->rounds = (uint16_t)((delay_ms - 1) / SCHED_WHEEL_SLOTS);
+    timer->event = event;
+    timer->active = true;
+    timer->next = sched_wheel[slot];
+    sched_wheel[slot] = timer;
+    __set_PRIMASK(primask);
+}
+
+/**
+ * @brief Stops a timer, its event is not posted.
+ */
+void scheduler_timer_stop(SchedTimer_t *timer)
+{
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    if (timer->active) {
+        scheduler_timer_unlink(timer);
+    }
+    __set_PRIMASK(primask);
+}
+
+/**
+ * @brief Returns true if any timer is running, the wheel then needs SysTick.
+ */
+bool scheduler_timers_active(void)
+{
+    for (uint8_t slot = 0; slot < SCHED_WHEEL_SLOTS; slot++) {
+        if (sched_wheel[slot] != NULL) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief Advances the timer wheel by one millisecond. Called from SysTick_Handler().
+ */
+void scheduler_tick(void)
+{
+    sched_cursor = (sched_cursor + 1) & SCHED_WHEEL_MASK;
+
+    SchedTimer_t **entry = &sched_wheel[sched_cursor];
+    while (*entry != NULL) {
+        SchedTimer_t *timer = *entry;
+        if (timer->rounds == 0) {
+            *entry = timer->next;
+            timer->active = false;
+            scheduler_post((SchedEvent_t)timer->event);
+        } else {
+            timer->rounds--;
+            entry = &timer->next;
+        }
+    }
+}
+
+/**
+ * @brief Runs the handlers of all pending events to completion, lowest event first,
+ *        or sleeps until an interrupt if nothing is pending. Call it from the main loop.
+ */
+void scheduler_dispatch(void)
+{
+    __disable_irq();
+    uint32_t pending = sched_pending;
+    sched_pending = 0;
+    if (pending == 0) {
+        // Checked and slept with interrupts masked, so a post cannot slip in between.
+        // A pending interrupt still ends the sleep and runs as soon as they are unmasked.
+        low_power_idle();
+    }
+    __enable_irq();
+
+    for (uint8_t event = 0; pending != 0; event++, pending >>= 1) {
+        if ((pending & 1u) && sched_handlers[event] != NULL) {
+            sched_handlers[event]();
+        }
+    }
+}
@@ -0,0 +1,219 @@
+#include "uart_tx.h"
+#include "usart.h"
+#include "scheduler.h"
+#include <string.h>
+
+#define UART1_TX_BLOCK_COUNT 4
+#define UART2_TX_BLOCK_SIZE 128  // Debug log, longer records span several blocks
+#define UART2_TX_BLOCK_COUNT 4
+
+// A fixed-size buffer that is owned by exactly one party at a time: the pool or the TX
+// engine queue.
+typedef struct UartTxBlock {
+    struct UartTxBlock *next;
+    uint8_t *data;
+    uint16_t len;
+} UartTxBlock_t;
+
+// Block pool and FIFO per UART. The DMA sends the block at the head of the queue straight
+// from the buffer it was written in; the TX complete interrupt returns it to the pool and
+// starts the next one, so writers never wait for the wire.
+typedef struct {
+    UART_HandleTypeDef *huart;
+    UartTxBlock_t *blocks;
+    uint8_t *storage;
+    uint16_t block_size;
+    uint8_t block_count;
+    UartTxBlock_t *free;       // Blocks nobody owns
+    UartTxBlock_t *queue_head; // Oldest queued block, on the wire while in_flight is set
+    UartTxBlock_t *queue_tail; // Newest queued block, small writes are appended to it
+    volatile bool in_flight;
+} UartTx_t;
+
+static UartTxBlock_t uart1_tx_blocks[UART1_TX_BLOCK_COUNT];
+static UartTxBlock_t uart2_tx_blocks[UART2_TX_BLOCK_COUNT];
+static uint8_t uart1_tx_storage[UART1_TX_BLOCK_COUNT * UART1_TX_BLOCK_SIZE];
+static uint8_t uart2_tx_storage[UART2_TX_BLOCK_COUNT * UART2_TX_BLOCK_SIZE];
+
+static UartTx_t uart1_tx = { &huart1, uart1_tx_blocks, uart1_tx_storage, UART1_TX_BLOCK_SIZE, UART1_TX_BLOCK_COUNT };
+static UartTx_t uart2_tx = { &huart2, uart2_tx_blocks, uart2_tx_storage, UART2_TX_BLOCK_SIZE, UART2_TX_BLOCK_COUNT };
+
+static UartTx_t *uart_tx_get(UART_HandleTypeDef *huart)
+{
+    if (huart->Instance == USART1) {
+        return &uart1_tx;
+    }
+    if (huart->Instance == USART2) {
+        return &uart2_tx;
+    }
+    return NULL;
+}
+
+static void uart_tx_pool_init(UartTx_t *tx)
+{
+    tx->free = NULL;
+    for (uint8_t i = tx->block_count; i-- > 0;) {
+        tx->blocks[i].data = &tx->storage[i * tx->block_size];
+        tx->blocks[i].len = 0;
+        tx->blocks[i].next = tx->free;
+        tx->free = &tx->blocks[i];
+    }
+    tx->queue_head = NULL;
+    tx->queue_tail = NULL;
+    tx->in_flight = false;
+}
+
+/**
+ * @brief Fills the block pools. Call once before anything is sent.
+ */
+void uart_tx_init(void)
+{
+    uart_tx_pool_init(&uart1_tx);
+    uart_tx_pool_init(&uart2_tx);
+}
+
+/**
+ * @brief Starts the DMA on the oldest queued block if it is idle.
+ *        Must run with interrupts disabled or from the TX complete interrupt.
+ */
+static void uart_tx_kick(UartTx_t *tx)
+{
+    if (tx->in_flight || tx->queue_head == NULL) {
+        return;
+    }
+
+    tx->in_flight = true;
+    if (HAL_UART_Transmit_DMA(tx->huart, tx->queue_head->data, tx->queue_head->len) != HAL_OK) {
+        tx->in_flight = false; // UART still busy, the next write or completion retries
+    }
+}
+
+/**
+ * @brief Appends a block to the queue. Must run with interrupts disabled.
+ */
+static void uart_tx_enqueue(UartTx_t *tx, UartTxBlock_t *block)
+{
+    block->next = NULL;
+    if (tx->queue_tail != NULL) {
+        tx->queue_tail->next = block;
+    } else {
+        tx->queue_head = block;
+    }
+    tx->queue_tail = block;
+}
+
+/**
+ * @brief Queues bytes for transmission and returns immediately.
+ *        Safe to call from the main loop and from interrupts.
+ *        The bytes go into the newest queued block when it is not on the wire yet and has
+ *        room, so short messages share blocks; otherwise they take fresh blocks.
+ * @param huart The UART to send on.
+ * @param data The bytes to send, copied before returning.
+ * @param len The number of bytes.
+ * @return true if queued, false if the pool had no room (the whole message is dropped).
+ */
+bool uart_tx_write(UART_HandleTypeDef *huart, const uint8_t *data, uint16_t len)
+{
+    UartTx_t *tx = uart_tx_get(huart);
+    bool queued = false;
+
+    if (tx == NULL) {
+        return false;
+    }
+
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+
+    UartTxBlock_t *last = tx->queue_tail;
+    bool last_open = (last != NULL) && !(tx->in_flight && last == tx->queue_head);
+
+    if (last_open && last->len + len <= tx->block_size) {
+        memcpy(&last->data[last->len], data, len);
+        last->len += len;
+        queued = true;
+    } else {
+        // Take every block the message needs, or none
+        uint16_t needed = (len + tx->block_size - 1) / tx->block_size;
+        uint16_t available = 0;
+        for (UartTxBlock_t *block = tx->free; block != NULL && available < needed; block = block->next) {
+            available++;
+        }
+
+        if (available == needed) {
+            while (len > 0) {
+                UartTxBlock_t *block = tx->free;
+                uint16_t chunk = (len < tx->block_size) ? len : tx->block_size;
+                tx->free = block->next;
+                memcpy(block->data, data, chunk);
+                block->len = chunk;
+                uart_tx_enqueue(tx, block);
+                data += chunk;
+                len -= chunk;
+            }
+            queued = true;
+        }
+    }
+
+    if (queued) {
+        uart_tx_kick(tx);
+    }
+
+    __set_PRIMASK(primask);
+    return queued;
+}
+
+/**
+ * @brief Returns true when neither UART has anything queued or on the wire.
+ */
+bool uart_tx_idle(void)
+{
+    return uart1_tx.queue_head == NULL && uart2_tx.queue_head == NULL;
+}
+
+/**
+ * @brief Stops the transfer on the wire and drops everything queued for a UART. Call it
+ *        before the UART is initialised again, which would end the DMA without a TX
+ *        complete interrupt and leave the block on the wire owned by nobody.
+ * @param huart The UART.
+ */
+void uart_tx_abort(UART_HandleTypeDef *huart)
+{
+    UartTx_t *tx = uart_tx_get(huart);
+
+    if (tx == NULL) {
+        return;
+    }
+
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    if (tx->in_flight) {
+        HAL_UART_AbortTransmit(huart);
+        tx->in_flight = false;
+    }
+    while (tx->queue_head != NULL) {
+        UartTxBlock_t *block = tx->queue_head;
+        tx->queue_head = block->next;
+        block->next = tx->free;
+        tx->free = block;
+    }
+    tx->queue_tail = NULL;
+    __set_PRIMASK(primask);
+}
+
+void HAL_UART_TxCpltCallback(UART_HandleTypeDef *huart)
+{
+    UartTx_t *tx = uart_tx_get(huart);
+
+    if (tx != NULL && tx->in_flight) {
+        UartTxBlock_t *block = tx->queue_head;
+        tx->queue_head = block->next;
+        if (tx->queue_head == NULL) {
+            tx->queue_tail = NULL;
+        }
+        block->next = tx->free;
+        tx->free = block;
+        tx->in_flight = false;
+        uart_tx_kick(tx);
+        scheduler_post(SCHED_EVENT_TX_DONE);
+    }
+}
@@ -0,0 +1,244 @@
+#include "zigbee_at.h"
+#include "zigbee_log.h"
+#include "usart.h"
+#include <string.h>
+
+/**
+ * @brief Points the engine at a step table and starts at the given step.
+ *        Nothing is sent until the next zigbee_at_run().
+ * @param at The engine.
+ * @param steps The step table, indexed by step number.
+ * @param step_count The number of steps in the table.
+ * @param phase_ms Where the time spent in each step is kept, step_count entries, cleared here.
+ * @param first The step to start with.
+ */
+void zigbee_at_start(ZigbeeAt_t *at, const ZigbeeAtStep_t *steps, uint8_t step_count, uint32_t *phase_ms,
+                     uint8_t first)
+{
+    at->steps = steps;
+    at->phase_ms = phase_ms;
+    at->step = first;
+    at->retries = 0;
+    at->waiting = false;
+    at->ahead = 0;
+    at->stale = 0;
+    at->hold_ms = 0;
+    at->enter_tick = HAL_GetTick();
+    at->last_tx_tick = at->enter_tick - ZIGBEE_AT_PIPELINE_GAP_MS;
+    memset(phase_ms, 0, step_count * sizeof(phase_ms[0]));
+}
+
+/**
+ * @brief Moves to a step, its command goes out on the next zigbee_at_run().
+ *        Going to the current step again is a retry and keeps counting.
+ *        If the step's command was already sent ahead, only its reply is awaited.
+ * @param at The engine.
+ * @param step The step to run next.
+ */
+void zigbee_at_goto(ZigbeeAt_t *at, uint8_t step)
+{
+    uint32_t now = HAL_GetTick();
+    bool sent_ahead = (at->ahead > 0) && (step == at->steps[at->step].matches[0].next);
+
+    if (step != at->step) {
+        at->phase_ms[at->step] += now - at->enter_tick;
+        at->enter_tick = now;
+        at->retries = 0;
+    }
+    at->step = step;
+
+    if (sent_ahead) {
+        at->ahead--;
+        at->sent_tick = now; // Its timeout counts from when it became the current step
+        at->waiting = true;
+    } else {
+        if (at->ahead > 0) {
+            at->stale_step = at->steps[at->step].matches[0].next;
+            at->stale = at->ahead;
+        }
+        at->ahead = 0;
+        at->waiting = false;
+    }
+}
+
+/**
+ * @brief Holds back the next command, replacing a blocking delay.
+ *        Lines received meanwhile are dropped.
+ * @param at The engine.
+ * @param delay_ms How long to wait, counted from now.
+ */
+void zigbee_at_delay(ZigbeeAt_t *at, uint32_t delay_ms)
+{
+    at->hold_tick = HAL_GetTick();
+    at->hold_ms = delay_ms;
+}
+
+/**
+ * @brief Counts a failed attempt at the current step and moves on to next,
+ *        or to the step's fail_next once its retries are used up.
+ */
+static void zigbee_at_retry(ZigbeeAt_t *at, uint8_t next)
+{
+    const ZigbeeAtStep_t *step = &at->steps[at->step];
+
+    if (next == at->step && step->max_retries != ZIGBEE_AT_RETRY_FOREVER && ++at->retries > step->max_retries) {
+        next = step->fail_next;
+    }
+    zigbee_at_goto(at, next);
+}
+
+/**
+ * @brief Tells whether a line is the reply to a command sent ahead of a step that was
+ *        then left. It is still on its way after the engine took another path and must
+ *        not count as a wrong answer to the step run instead.
+ */
+static bool zigbee_at_is_stale(const ZigbeeAt_t *at, const uint8_t *line, uint16_t len)
+{
+    uint8_t step = at->stale_step;
+
+    for (uint8_t i = 0; i < at->stale; i++) {
+        const char *prefix = at->steps[step].matches[0].prefix;
+        uint16_t prefix_len = strlen(prefix);
+        if (len >= prefix_len && memcmp(line, prefix, prefix_len) == 0) {
+            return true;
+        }
+        step = at->steps[step].matches[0].next;
+    }
+    return false;
+}
+
+static void zigbee_at_send(ZigbeeAt_t *at, const ZigbeeAtStep_t *step)
+{
+    uart_tx_write(&huart1, (const uint8_t *)step->command, strlen(step->command));
+    at->last_tx_tick = HAL_GetTick();
+}
+
+/**
+ * @brief Sends the command of the next step on the expected path early if that step
+ *        is pipelined and the gap since the last command has passed.
+ */
+static void zigbee_at_pipeline(ZigbeeAt_t *at)
+{
+#if ZIGBEE_AT_PIPELINE_GAP_MS > 0
+    uint8_t last = at->step;
+    for (uint8_t i = 0; i < at->ahead; i++) {
+        last = at->steps[last].matches[0].next;
+    }
+
+    const ZigbeeAtStep_t *next = &at->steps[at->steps[last].matches[0].next];
+    if (at->steps[last].matches[0].prefix != NULL && next->pipelined && next->command != NULL &&
+        HAL_GetTick() - at->last_tx_tick >= ZIGBEE_AT_PIPELINE_GAP_MS) {
+        zigbee_at_send(at, next);
+        at->ahead++;
+    }
+#else
+    (void)at;
+#endif
+}
+
+/**
+ * @brief Runs the current step: sends its command, checks its timeout and matches
+ *        the received line against its expected replies.
+ * @param at The engine.
+ * @param line The oldest received line, or NULL. Not null-terminated.
+ * @param len The number of characters in line.
+ * @return true if the line was used and should be released.
+ */
+bool zigbee_at_run(ZigbeeAt_t *at, const uint8_t *line, uint16_t len)
+{
+    const ZigbeeAtStep_t *step = &at->steps[at->step];
+
+    if (step->command == NULL) {
+        return false;
+    }
+
+    if (!at->waiting) {
+        if (at->hold_ms != 0 && HAL_GetTick() - at->hold_tick >= at->hold_ms) {
+            at->hold_ms = 0;
+        }
+        // Held back, or keeping the previous command a frame of its own. Nothing is asked
+        // yet, so a line now is a late reply to an earlier command: drop it, left in the
+        // queue it would have the main loop spin on it until the command goes out.
+        if (at->hold_ms != 0 || HAL_GetTick() - at->last_tx_tick < ZIGBEE_AT_PIPELINE_GAP_MS) {
+            if (line != NULL) {
+                ZB_LOG_DEBUG_TEXT(ZB_MSG_RX_LINE, line, len);
+            }
+            return line != NULL;
+        }
+        zigbee_at_send(at, step);
+        at->sent_tick = at->last_tx_tick;
+        at->waiting = true;
+    }
+
+    zigbee_at_pipeline(at);
+
+    if (line == NULL) {
+        if (HAL_GetTick() - at->sent_tick > step->timeout_ms) {
+            if (step->timeout_msg != ZIGBEE_AT_NO_MSG) {
+                ZB_LOG_WARN(step->timeout_msg);
+            }
+            at->stale = 0; // The module has gone quiet, nothing is on its way anymore
+            zigbee_at_retry(at, at->step);
+        }
+        return false;
+    }
+
+    ZB_LOG_DEBUG_TEXT(ZB_MSG_RX_LINE, line, len);
+
+    for (const ZigbeeAtMatch_t *match = step->matches;
+         match < &step->matches[ZIGBEE_AT_MAX_MATCHES] && match->prefix != NULL; match++) {
+        uint16_t prefix_len = strlen(match->prefix);
+        if (len >= prefix_len && memcmp(line, match->prefix, prefix_len) == 0) {
+            if (match->log_msg != ZIGBEE_AT_NO_MSG) {
+                ZB_LOG_INFO(match->log_msg);
+            }
+            at->stale = 0; // The module answers in order, the stale replies came before
+            zigbee_at_goto(at, (match->action != NULL) ? match->action(line, len) : match->next);
+            return true;
+        }
+    }
+
+    if (zigbee_at_is_stale(at, line, len)) {
+        return true;
+    }
+
+    if (step->mismatch_msg != ZIGBEE_AT_NO_MSG) {
+        ZB_LOG_WARN(step->mismatch_msg);
+    }
+    zigbee_at_retry(at, step->mismatch_next);
+    return true;
+}
+
+/**
+ * @brief Tells how soon zigbee_at_run() has something to do without a new line:
+ *        a timeout, the end of a delay, or the pipeline gap.
+ * @param at The engine.
+ * @return Milliseconds until then, or 0 if it only waits for lines.
+ */
+uint32_t zigbee_at_next_ms(const ZigbeeAt_t *at)
+{
+    const ZigbeeAtStep_t *step = &at->steps[at->step];
+    uint32_t now = HAL_GetTick();
+    uint32_t gap_left = 0;
+    uint32_t wait;
+
+    if (step->command == NULL) {
+        return 0;
+    }
+
+    if (now - at->last_tx_tick < ZIGBEE_AT_PIPELINE_GAP_MS) {
+        gap_left = ZIGBEE_AT_PIPELINE_GAP_MS - (now - at->last_tx_tick);
+    }
+
+    if (!at->waiting) {
+        if (at->hold_ms != 0 && now - at->hold_tick < at->hold_ms) {
+            wait = at->hold_ms - (now - at->hold_tick);
+            return (wait > gap_left) ? wait : gap_left;
+        }
+        return (gap_left != 0) ? gap_left : 1;
+    }
+
+    // The timeout test is "longer than", so wake one tick after it
+    wait = (now - at->sent_tick <= step->timeout_ms) ? step->timeout_ms - (now - at->sent_tick) + 1 : 1;
+    return (gap_left != 0 && gap_left < wait) ? gap_left : wait;
+}
@@ -0,0 +1,49 @@
+#include "zigbee_log.h"
+#include "usart.h"
+#include "profiler.h"
+#include <string.h>
+
+/**
+ * @brief Packs one log record and queues it on the USART2 TX ring.
+ *        Safe from interrupt context, the record is built on the caller's stack.
+ *        Text that does not fit in ZB_LOG_PAYLOAD_MAX is cut short.
+ * @param id The message ID, one of ZigbeeLogMsg_t.
+ * @param args The 32-bit arguments, in format order.
+ * @param nargs The number of arguments.
+ * @param text Text for a trailing %s, or NULL.
+ * @param text_len The number of characters in text.
+ */
+void zigbee_log_write(uint8_t id, const int32_t *args, uint8_t nargs, const uint8_t *text, uint16_t text_len)
+{
+    uint8_t record[3 + ZB_LOG_PAYLOAD_MAX + 1];
+    uint16_t len = 0;
+    uint8_t check;
+
+    PROF_BEGIN(PROF_LOG_WRITE);
+    while (nargs-- > 0 && len + 4 <= ZB_LOG_PAYLOAD_MAX) {
+        uint32_t value = (uint32_t)*args++;
+        record[3 + len++] = (uint8_t)value;
+        record[3 + len++] = (uint8_t)(value >> 8);
+        record[3 + len++] = (uint8_t)(value >> 16);
+        record[3 + len++] = (uint8_t)(value >> 24);
+    }
+    if (text != NULL) {
+        if (text_len > ZB_LOG_PAYLOAD_MAX - len) {
+            text_len = ZB_LOG_PAYLOAD_MAX - len;
+        }
+        memcpy(&record[3 + len], text, text_len);
+        len += text_len;
+    }
+
+    record[0] = ZB_LOG_SYNC;
+    record[1] = id;
+    record[2] = (uint8_t)len;
+    check = id ^ (uint8_t)len;
+    for (uint16_t i = 0; i < len; i++) {
+        check ^= record[3 + i];
+    }
+    record[3 + len] = check;
+
+    uart_tx_write(&huart2, record, 3 + len + 1);
+    PROF_END(PROF_LOG_WRITE);
+}
@@ -0,0 +1,116 @@
+#include "zigbee_reply.h"
+#include <string.h>
+
+#define ZIGBEE_REPLY_QUEUE_SIZE 256 // Must be a power of two
+#define ZIGBEE_REPLY_QUEUE_MASK (ZIGBEE_REPLY_QUEUE_SIZE - 1)
+
+// Records waiting for a poll, each stored as [length][bytes] and wrapping around freely.
+// The application appends at reply_head; the slot reply interrupt drops sent records by
+// moving reply_tail. Each index has a single writer, so neither side needs a lock.
+static uint8_t reply_queue[ZIGBEE_REPLY_QUEUE_SIZE];
+static volatile uint16_t reply_head = 0;
+static volatile uint16_t reply_tail = 0;
+static volatile uint16_t reply_pushed = 0; // Records ever queued, written by zigbee_reply_push()
+static volatile uint16_t reply_sent = 0;   // Records ever sent, written by zigbee_reply_commit()
+
+// What the frame built last takes out of the queue once it is sent
+static uint16_t reply_built_tail = 0;
+static uint16_t reply_built_records = 0;
+static uint8_t reply_seq = 0;
+
+/**
+ * @brief Queues an application record for the next replies. Call from thread mode.
+ * @param data The record.
+ * @param len The record length, 1 to ZIGBEE_REPLY_RECORD_MAX.
+ * @return false if the record is too long or the queue is full.
+ */
+bool zigbee_reply_push(const uint8_t *data, uint8_t len)
+{
+    uint16_t head = reply_head;
+
+    if (len == 0 || len > ZIGBEE_REPLY_RECORD_MAX ||
+        (uint16_t)(head - reply_tail) + 1 + len > ZIGBEE_REPLY_QUEUE_SIZE) {
+        return false;
+    }
+
+    reply_queue[head & ZIGBEE_REPLY_QUEUE_MASK] = len;
+    for (uint8_t i = 0; i < len; i++) {
+        reply_queue[(head + 1 + i) & ZIGBEE_REPLY_QUEUE_MASK] = data[i];
+    }
+    __DMB(); // The record must be complete before a reply can see it
+    reply_head = head + 1 + len;
+    reply_pushed++;
+    return true;
+}
+
+/**
+ * @brief Returns the number of records waiting to be sent.
+ */
+uint16_t zigbee_reply_pending(void)
+{
+    return (uint16_t)(reply_pushed - reply_sent);
+}
+
+/**
+ * @brief Packs as many queued records, oldest first, as fit in one reply frame.
+ *        The records stay queued until zigbee_reply_commit(). Call from thread mode
+ *        with no reply scheduled, the commit must not run while the frame is built.
+ * @param id Our ID.
+ * @param max_len The longest frame the slot has room for, at most ZIGBEE_REPLY_MAX_FRAME.
+ * @param frame The output buffer, max_len bytes.
+ * @return The frame length, or 0 if nothing is queued (or the oldest record does not fit).
+ */
+uint16_t zigbee_reply_build(uint16_t id, uint16_t max_len, uint8_t *frame)
+{
+    uint8_t payload[ZIGBEE_REPLY_MAX_FRAME - MBMP_FRAME_OVERHEAD];
+    uint16_t room = (max_len > ZIGBEE_REPLY_MAX_FRAME) ? sizeof(payload) : max_len - MBMP_FRAME_OVERHEAD;
+    uint16_t used = ZIGBEE_REPLY_HEADER_LEN;
+    uint16_t pos = reply_tail;
+    uint16_t head = reply_head;
+    uint8_t records = 0;
+
+    reply_built_records = 0;
+    if (max_len <= MBMP_FRAME_OVERHEAD + ZIGBEE_REPLY_HEADER_LEN) {
+        return 0;
+    }
+
+    __DMB(); // Read records only after seeing the published head
+    while (pos != head) {
+        uint8_t len = reply_queue[pos & ZIGBEE_REPLY_QUEUE_MASK];
+        if (used + 1 + len > room) {
+            break;
+        }
+        for (uint16_t i = 0; i <= len; i++) {
+            payload[used + i] = reply_queue[(pos + i) & ZIGBEE_REPLY_QUEUE_MASK];
+        }
+        used += 1 + len;
+        pos += 1 + len;
+        records++;
+    }
+    if (records == 0) {
+        return 0;
+    }
+
+    payload[0] = (uint8_t)id;
+    payload[1] = (uint8_t)(id >> 8);
+    payload[2] = reply_seq;
+    payload[3] = records;
+    reply_built_tail = pos;
+    reply_built_records = records;
+    return (uint16_t)mbmp_frame_encode(MBMP_FRAME_REPLY, payload, used, frame, max_len);
+}
+
+/**
+ * @brief Drops the records of the frame built last, now that it is on its way.
+ *        Called from the slot reply interrupt; does nothing a second time.
+ */
+void zigbee_reply_commit(void)
+{
+    if (reply_built_records == 0) {
+        return;
+    }
+    reply_tail = reply_built_tail;
+    reply_sent += reply_built_records;
+    reply_built_records = 0;
+    reply_seq++;
+}
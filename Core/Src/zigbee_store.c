@@ -0,0 +1,147 @@
+#include "zigbee_store.h"
+#include <stddef.h>
+#include <string.h>
+
+// The last two flash pages, kept out of the code region in the linker settings. Records are
+// appended one after the other; when a page is full the other one is erased and written next,
+// so each page is erased once per ZIGBEE_STORE_SLOTS saves.
+#define ZIGBEE_STORE_PAGE0 (FLASH_BANK1_END + 1 - 2 * FLASH_PAGE_SIZE)
+#define ZIGBEE_STORE_PAGE1 (FLASH_BANK1_END + 1 - FLASH_PAGE_SIZE)
+#define ZIGBEE_STORE_MAGIC 0x5A42
+#define ZIGBEE_STORE_SLOTS (FLASH_PAGE_SIZE / sizeof(ZigbeeStoreRecord_t))
+
+typedef struct {
+    uint16_t magic;
+    uint16_t seq;            // Incremented on every save, the highest valid one is current
+    ZigbeeStoreData_t data;
+    uint32_t check;          // zigbee_store_hash() of everything above
+} ZigbeeStoreRecord_t;
+
+static const uint32_t zigbee_store_pages[2] = { ZIGBEE_STORE_PAGE0, ZIGBEE_STORE_PAGE1 };
+
+/**
+ * @brief FNV-1a hash, chainable: pass the result back in to hash more data.
+ * @param data The bytes to hash.
+ * @param len The number of bytes.
+ * @param hash ZIGBEE_STORE_HASH_INIT, or the result of a previous call.
+ * @return The updated hash.
+ */
+uint32_t zigbee_store_hash(const void *data, uint32_t len, uint32_t hash)
+{
+    const uint8_t *bytes = data;
+    while (len--) {
+        hash = (hash ^ *bytes++) * 0x01000193u;
+    }
+    return hash;
+}
+
+static const ZigbeeStoreRecord_t *zigbee_store_slot(uint8_t page, uint16_t slot)
+{
+    return (const ZigbeeStoreRecord_t *)(zigbee_store_pages[page] + slot * sizeof(ZigbeeStoreRecord_t));
+}
+
+static bool zigbee_store_is_valid(const ZigbeeStoreRecord_t *record)
+{
+    return record->magic == ZIGBEE_STORE_MAGIC &&
+           record->check == zigbee_store_hash(record, offsetof(ZigbeeStoreRecord_t, check), ZIGBEE_STORE_HASH_INIT);
+}
+
+static bool zigbee_store_is_blank(const ZigbeeStoreRecord_t *record)
+{
+    const uint32_t *word = (const uint32_t *)record;
+    for (uint16_t i = 0; i < sizeof(ZigbeeStoreRecord_t) / 4; i++) {
+        if (word[i] != 0xFFFFFFFFu) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Finds the current record: the valid one with the highest sequence number.
+ * @param page Set to the page holding it.
+ * @return The record, or NULL if there is none.
+ */
+static const ZigbeeStoreRecord_t *zigbee_store_find(uint8_t *page)
+{
+    const ZigbeeStoreRecord_t *best = NULL;
+
+    for (uint8_t p = 0; p < 2; p++) {
+        for (uint16_t slot = 0; slot < ZIGBEE_STORE_SLOTS; slot++) {
+            const ZigbeeStoreRecord_t *record = zigbee_store_slot(p, slot);
+            if (zigbee_store_is_valid(record) && (best == NULL || (int16_t)(record->seq - best->seq) > 0)) {
+                best = record;
+                *page = p;
+            }
+        }
+    }
+    return best;
+}
+
+/**
+ * @brief Reads the last saved record.
+ * @param data Filled with the record.
+ * @return true if a valid record was found.
+ */
+bool zigbee_store_load(ZigbeeStoreData_t *data)
+{
+    uint8_t page;
+    const ZigbeeStoreRecord_t *record = zigbee_store_find(&page);
+
+    if (record == NULL) {
+        return false;
+    }
+    memcpy(data, &record->data, sizeof(*data));
+    return true;
+}
+
+/**
+ * @brief Appends a record, unless it matches the current one. Blocks while the flash is
+ *        programmed, up to a page erase (~20 ms), so call it outside time-critical paths.
+ * @param data The record to save.
+ * @return true if the record is in flash.
+ */
+bool zigbee_store_save(const ZigbeeStoreData_t *data)
+{
+    uint8_t page = 0;
+    const ZigbeeStoreRecord_t *current = zigbee_store_find(&page);
+    ZigbeeStoreRecord_t record;
+    uint16_t slot = 0;
+    bool ok = true;
+
+    if (current != NULL && memcmp(&current->data, data, sizeof(*data)) == 0) {
+        return true; // Nothing changed, spare the flash
+    }
+
+    memset(&record, 0, sizeof(record));
+    record.magic = ZIGBEE_STORE_MAGIC;
+    record.seq = (current != NULL) ? current->seq + 1 : 0;
+    memcpy(&record.data, data, sizeof(*data));
+    record.check = zigbee_store_hash(&record, offsetof(ZigbeeStoreRecord_t, check), ZIGBEE_STORE_HASH_INIT);
+
+    // First slot after the last used one; a slot a reset left half-written is skipped too
+    for (slot = ZIGBEE_STORE_SLOTS; slot > 0 && zigbee_store_is_blank(zigbee_store_slot(page, slot - 1)); slot--) {
+    }
+
+    HAL_FLASH_Unlock();
+    if (slot >= ZIGBEE_STORE_SLOTS) {
+        FLASH_EraseInitTypeDef erase = { 0 };
+        uint32_t page_error = 0;
+
+        page ^= 1;
+        slot = 0;
+        erase.TypeErase = FLASH_TYPEERASE_PAGES;
+        erase.PageAddress = zigbee_store_pages[page];
+        erase.NbPages = 1;
+        ok = (HAL_FLASHEx_Erase(&erase, &page_error) == HAL_OK);
+    }
+
+    uint32_t address = zigbee_store_pages[page] + slot * sizeof(ZigbeeStoreRecord_t);
+    const uint32_t *word = (const uint32_t *)&record;
+    for (uint16_t i = 0; ok && i < sizeof(record) / 4; i++) {
+        ok = (HAL_FLASH_Program(FLASH_TYPEPROGRAM_WORD, address + i * 4, word[i]) == HAL_OK);
+    }
+    HAL_FLASH_Lock();
+
+    return ok && zigbee_store_is_valid(zigbee_store_slot(page, slot));
+}
@@ -0,0 +1,127 @@
+#include "zigbee_timer.h"
+#include <stdbool.h>
+
+// TIM2 counts microseconds (64 MHz / 64) from 0 to 0xFFFF. Its update interrupt extends the
+// count to 32 bits, and output compare channel 1 fires a single scheduled callback.
+#define ZIGBEE_TIMER_EPOCH_US 0x10000u
+#define ZIGBEE_TIMER_MIN_LEAD_US 4 // Closer deadlines run at once, the compare could be missed
+
+static volatile uint32_t timer_epoch_us = 0; // Upper part of the microsecond clock
+static volatile uint32_t timer_deadline_us = 0;
+static volatile ZigbeeTimerCallback_t timer_callback = NULL;
+
+/**
+ * @brief Starts the free-running microsecond clock.
+ */
+void zigbee_timer_start(void)
+{
+    timer_epoch_us = 0;
+    timer_callback = NULL;
+    __HAL_TIM_SET_COUNTER(&htim2, 0);
+    HAL_TIM_Base_Start_IT(&htim2);
+}
+
+/**
+ * @brief Returns the microseconds since zigbee_timer_start(), wrapping after ~71 minutes.
+ *        Safe to call from interrupts that block the TIM2 interrupt.
+ */
+uint32_t zigbee_timer_now_us(void)
+{
+    uint32_t epoch;
+    uint32_t count;
+
+    do {
+        epoch = timer_epoch_us;
+        count = __HAL_TIM_GET_COUNTER(&htim2);
+    } while (epoch != timer_epoch_us);
+
+    // An overflow that the update interrupt has not handled yet (we may be running above it)
+    if (__HAL_TIM_GET_FLAG(&htim2, TIM_FLAG_UPDATE) && count < ZIGBEE_TIMER_EPOCH_US / 2) {
+        epoch += ZIGBEE_TIMER_EPOCH_US;
+    }
+    return epoch + count;
+}
+
+/**
+ * @brief Fires the pending callback once.
+ */
+static void zigbee_timer_fire(void)
+{
+    ZigbeeTimerCallback_t callback = timer_callback;
+
+    __HAL_TIM_DISABLE_IT(&htim2, TIM_IT_CC1);
+    timer_callback = NULL;
+    if (callback != NULL) {
+        callback();
+    }
+}
+
+/**
+ * @brief Points the compare channel at the deadline once it falls inside the current
+ *        16-bit counter period; later deadlines are re-checked on every overflow.
+ */
+static void zigbee_timer_arm(void)
+{
+    int32_t remaining = (int32_t)(timer_deadline_us - zigbee_timer_now_us());
+
+    if (remaining <= ZIGBEE_TIMER_MIN_LEAD_US) {
+        zigbee_timer_fire();
+    } else if ((uint32_t)remaining < ZIGBEE_TIMER_EPOCH_US) {
+        __HAL_TIM_SET_COMPARE(&htim2, TIM_CHANNEL_1, timer_deadline_us & 0xFFFFu);
+        __HAL_TIM_CLEAR_FLAG(&htim2, TIM_FLAG_CC1);
+        __HAL_TIM_ENABLE_IT(&htim2, TIM_IT_CC1);
+    }
+}
+
+/**
+ * @brief Runs callback from the TIM2 interrupt at deadline_us (zigbee_timer_now_us() time),
+ *        or straight away if the deadline is already due.
+ *        Only one callback is pending at a time; scheduling again replaces it.
+ * @param deadline_us The absolute time to fire at.
+ * @param callback The function to run.
+ */
+void zigbee_timer_schedule_at(uint32_t deadline_us, ZigbeeTimerCallback_t callback)
+{
+    HAL_NVIC_DisableIRQ(TIM2_IRQn);
+    __HAL_TIM_DISABLE_IT(&htim2, TIM_IT_CC1);
+    timer_deadline_us = deadline_us;
+    timer_callback = callback;
+    zigbee_timer_arm();
+    HAL_NVIC_EnableIRQ(TIM2_IRQn);
+}
+
+/**
+ * @brief Drops the pending callback, if any.
+ */
+void zigbee_timer_cancel(void)
+{
+    HAL_NVIC_DisableIRQ(TIM2_IRQn);
+    __HAL_TIM_DISABLE_IT(&htim2, TIM_IT_CC1);
+    timer_callback = NULL;
+    HAL_NVIC_EnableIRQ(TIM2_IRQn);
+}
+
+/**
+ * @brief Returns true while a callback is waiting to fire.
+ */
+bool zigbee_timer_armed(void)
+{
+    return timer_callback != NULL;
+}
+
+void HAL_TIM_PeriodElapsedCallback(TIM_HandleTypeDef *htim)
+{
+    if (htim->Instance == TIM2) {
+        timer_epoch_us += ZIGBEE_TIMER_EPOCH_US;
+        if (timer_callback != NULL) {
+            zigbee_timer_arm();
+        }
+    }
+}
+
+void HAL_TIM_OC_DelayElapsedCallback(TIM_HandleTypeDef *htim)
+{
+    if (htim->Instance == TIM2 && htim->Channel == HAL_TIM_ACTIVE_CHANNEL_1) {
+        zigbee_timer_fire();
+    }
+}
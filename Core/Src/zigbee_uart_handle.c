@@ -1,44 +1,105 @@
 #include "zigbee_uart_handle.h"
+#include "mbmp.h"
+#include "zigbee_timer.h"
+#include "zigbee_log.h"
+#include "zigbee_at.h"
+#include "zigbee_store.h"
+#include "scheduler.h"
+#include "zigbee_reply.h"
+#include "console.h"
+#include "latency.h"
+#include "profiler.h"
 #include <stdbool.h>
 #include <string.h> // Required for string comparison functions like strncmp
 #include <stdlib.h> // Required for atoi
-#include <ctype.h>  // Required for isxdigit, tolower
+#include <ctype.h>
 
-#define RX_BUFFER_SIZE 512
-uint8_t rx_buffer[RX_BUFFER_SIZE];
-uint8_t rx_data;
-volatile uint16_t rx_index = 0;
-volatile uint8_t data_ready = 0;
-volatile uint8_t rejoin_detect = 0;
+#define RX_DMA_BUFFER_SIZE 256 // Circular DMA ring, must hold the longest burst between two RX events
+#define RX_LINE_MAX_LEN 160    // "MBMP:" + 128 hex chars + "\r\n", or the longest binary frame, fits with margin
+#define RX_LINE_QUEUE_DEPTH 4  // Must be a power of two
+#define RX_LINE_QUEUE_MASK (RX_LINE_QUEUE_DEPTH - 1)
+
+// A received line is a length-delimited view: data is NOT null-terminated and
+// len excludes the trailing "\r\n". Handlers read it in place and never copy or clear it.
+typedef struct {
+    uint16_t len;
+    int16_t mbmp_slot;  // Decision of the streaming MBMP parser, see mbmp_stream_end()
+    uint32_t end_us;    // zigbee_timer_now_us() estimate of when the '\n' finished arriving
+    uint8_t data[RX_LINE_MAX_LEN];
+} ZigbeeRxLine_t;
+
+uint8_t rx_dma_buffer[RX_DMA_BUFFER_SIZE];
+volatile uint16_t rx_dma_read_pos = 0;
+
+// Single-producer (USART1 RX event ISR) / single-consumer (zigbee_run) queue of complete lines.
+// The ISR assembles the next line directly in the slot at rx_line_head and only publishes it
+// by advancing rx_line_head; the main loop only ever advances rx_line_tail.
+static ZigbeeRxLine_t rx_line_queue[RX_LINE_QUEUE_DEPTH];
+static volatile uint8_t rx_line_head = 0;
+static volatile uint8_t rx_line_tail = 0;
+static uint16_t rx_index = 0;      // Write position inside the line being assembled (ISR only)
+static bool rx_line_discard = false; // Drop bytes until the next '\n' (ISR only)
+static volatile uint32_t rx_line_overflow_count = 0; // Lines lost because the queue was full, written by the ISR
+static uint32_t rx_line_overflow_logged = 0;          // rx_line_overflow_count when last logged
+static MbmpStream_t rx_mbmp_stream;  // Parses MBMP polls while they are received (ISR only)
+static volatile int zigbee_self_id = 0; // Numeric form of zigbee_info.zigbee_id, 0 until known
+static uint8_t zigbee_id_reply_len = 0; // Bytes of zigbee_info.zigbee_id_uart_data to send
+static uint8_t zigbee_reply_frame[ZIGBEE_REPLY_MAX_FRAME]; // Batched records for the next slot
+static uint16_t zigbee_reply_frame_len = 0; // 0: the slot carries the plain ID line
+static uint32_t zigbee_reply_due_us = 0; // Start of the slot the scheduled reply is for
+static uint8_t rejoin_detect = 0;      // NWK=2 reports since we were last in a network or left it
+static uint8_t rejoin_backoff = 0;     // Backoff doublings since we were last in a network
+static bool join_sent = false;          // AT+JOIN went out since we were last in a network
+static uint32_t rejoin_jitter_state = 0; // xorshift32 state, seeded from the chip UID
+static uint8_t get_id_timeouts = 0;      // GETID requests unanswered in a row
+static uint32_t get_id_sent_tick = 0;    // HAL_GetTick() when the last GETID went out
+static volatile uint32_t rx_last_tick = 0; // HAL_GetTick() of the last bytes received (ISR only)
 
-volatile uint32_t state_enter_tick = 0;
 #define ZIGBEE_RESPONSE_TIMEOUT 5000 // 5 seconds
-#define ZIGBEE_INTERVAL_RESPONSE 10  // 60 ms
+#define ZIGBEE_INTERVAL_RESPONSE_US 10000 // Slot width, 10 ms
+#define ZIGBEE_UART_CHAR_BITS 10           // Start + 8 data + stop bits on the wire
+#define ZIGBEE_REPLY_GUARD_US 2000           // Part of the slot a reply frame leaves free
+#define ZIGBEE_ID_MAX_DIGITS 4             // Fits the saved ID; IDs past 512 need ID list polls
+#define ZIGBEE_ADDR_DIGITS 4               // "ADDR=0x4653": the short address, in hex
 #define ZIGBEE_MAX_NETWORK_RETRY 12
+#define ZIGBEE_GET_ID_MAX_TIMEOUTS 3 // Unanswered GETIDs before the network and address are checked again
+#define ZIGBEE_REJOIN_BASE_MS 1000  // First rejoin backoff, doubled on every further NWK=2
+#define ZIGBEE_REJOIN_CAP_MS 60000  // Longest rejoin backoff
+#define ZIGBEE_RESET_DELAY_MS 500   // Pause after resetting a module that stopped answering
+#define ZIGBEE_STORE_QUIET_MS 30    // Link silence a flash page erase fits in
+#define ZIGBEE_STORE_MAX_DEFER_MS 60000 // Saved anyway after this long, even on a busy link
+#define ZIGBEE_RUN_BURST 8          // zigbee_run() calls per event before yielding
+#define ZIGBEE_BAUD_DEFAULT 115200  // Factory rate of the module, and the fallback
+#ifndef ZIGBEE_BAUD_FAST
+#define ZIGBEE_BAUD_FAST 460800     // Negotiated after AT_MODE, plain decimal; 0 stays at the default
+#endif
+#define ZIGBEE_BAUD_PROBE_RETRIES 3 // "+AT" knocks left at one rate before trying the next
+#define ZIGBEE_BAUD_SETTLE_MS 50    // Time the module gets to switch after confirming a new rate
+#define ZIGBEE_STR_(x) #x
+#define ZIGBEE_STR(x) ZIGBEE_STR_(x)
 /* --------------------------- State Machine Definitions -------------------------- */
 
-// Define the states for our Zigbee startup flow
+// Steps of the Zigbee startup flow, indices into zigbee_startup_steps[]
 typedef enum {
-    ZB_STARTUP_BEGIN,              // Start the process
-    ZB_STARTUP_SEND_NWK_CHECK,     // Send "AT+NWK?"
-    ZB_STARTUP_WAIT_NWK_STATUS,    // Wait for the "NWK=..." response
-    ZB_STARTUP_SEND_JOIN,          // Not in a network, so send "AT+JOIN"
-    ZB_STARTUP_WAIT_JOIN_OK,       // Wait for "OK" after sending AT+JOIN
-    ZB_STARTUP_WAIT_JOIN_COMPLETE, // Wait for the async "NWK JOINED" message
-    ZB_STARTUP_DONE,               // Process finished successfully
-    ZB_STARTUP_ERROR,              // An error occurred
-    ZB_STARTUP_EXIT_AT,            // Exit AT mode
-    ZB_STARTUP_WAIT_EXIT_OK,       // Wait for "OK" after exiting AT mode
-    ZB_STARTUP_GET_ADDR,
-    ZB_STARTUP_WAIT_ADDR_OK,
-    ZB_STARTUP_SET_DSTADDR,
-    ZB_STARTUP_WAIT_DSTADDR_OK,
-    ZB_STARTUP_SET_DSTEP,
-    ZB_STARTUP_WAIT_DSTEP_OK,
-    ZB_STARTUP_SET_CHANNEL,
-    ZB_STARTUP_WAIT_CHANNEL_OK,
-    ZB_STARTUP_DEV_CHECK,
-    ZB_STARTUP_WAIT_DEV_OK
+    ZB_STARTUP_BEGIN,       // Enter AT mode with "+AT", wait for "AT_MODE"
+    ZB_STARTUP_SET_BAUD,    // "AT+BAUD=460800", then switch USART1 over
+    ZB_STARTUP_CHECK_BAUD,  // "AT+DEV?" at the new rate
+    ZB_STARTUP_VERIFY_ADDR, // Warm boot: "AT+ADDR?" must match the saved address
+    ZB_STARTUP_DEV_CHECK,   // "AT+DEV?"
+    ZB_STARTUP_NWK_CHECK,   // "AT+NWK?"
+    ZB_STARTUP_SET_CHANNEL, // Not in a network: "AT+CH=11"
+    ZB_STARTUP_JOIN,        // "AT+JOIN", then check the network again
+    ZB_STARTUP_GET_ADDR,    // "AT+ADDR?"
+    ZB_STARTUP_SET_DSTADDR, // "AT+DSTADDR=0x0000"
+    ZB_STARTUP_SET_DSTEP,   // "AT+DSTEP=0x01"
+    ZB_STARTUP_EXIT_AT,     // Exit AT mode
+    ZB_STARTUP_LEAVE,       // Rejoins kept failing: "AT+LEAVE", then restart
+    ZB_STARTUP_RESTART,     // Left the network: zigbee_run() resets the module, rejoins after a backoff
+    ZB_STARTUP_RESET,       // The module stopped answering: zigbee_run() resets it and starts over
+    ZB_STARTUP_NEXT_BAUD,   // No banner: zigbee_run() moves USART1 to the next rate to probe
+    ZB_STARTUP_BAUD_FALLBACK, // The faster rate failed: zigbee_run() resets the module, back to the default
+    ZB_STARTUP_DONE,        // Process finished successfully
+    ZB_STARTUP_STEP_COUNT
 } ZigbeeStartupState_t;
 
 typedef enum {
@@ -54,488 +115,828 @@ typedef struct {
 } ZigbeeInfo_t;
 
 // Create a global variable to hold the current state
-volatile ZigbeeStartupState_t zigbee_startup_state = ZB_STARTUP_BEGIN;
 volatile ZigbeeInitState_t zigbee_init_info_state = ZB_INIT_INFO_GET_ID;
 volatile ZigbeeInfo_t zigbee_info;
 
-void zigbee_network_init_manager(void);
-void zigbee_get_id_manager(void);
+static uint8_t zigbee_startup_at_mode(const uint8_t *data, uint16_t len);
+static uint8_t zigbee_startup_baud_switch(const uint8_t *data, uint16_t len);
+static uint8_t zigbee_startup_baud_ok(const uint8_t *data, uint16_t len);
+static uint8_t zigbee_startup_baud_refused(const uint8_t *data, uint16_t len);
+static uint8_t zigbee_startup_verify_addr(const uint8_t *data, uint16_t len);
+static uint8_t zigbee_startup_store_addr(const uint8_t *data, uint16_t len);
+static uint8_t zigbee_startup_nwk_online(const uint8_t *data, uint16_t len);
+static uint8_t zigbee_startup_nwk_offline(const uint8_t *data, uint16_t len);
+static uint8_t zigbee_startup_nwk_not_joined(const uint8_t *data, uint16_t len);
+
+// The startup flow, one AT transaction per step, run by zigbee_at_run()
+static const ZigbeeAtStep_t zigbee_startup_steps[ZB_STARTUP_STEP_COUNT] = {
+    [ZB_STARTUP_BEGIN] = {
+        // Knocks every 250 ms until the module has booted and answers with its banner,
+        // trying the next baud rate after every ZIGBEE_BAUD_PROBE_RETRIES silent knocks
+        "+AT", 250, ZIGBEE_BAUD_PROBE_RETRIES, ZB_STARTUP_NEXT_BAUD, ZB_STARTUP_BEGIN,
+        ZIGBEE_AT_NO_MSG, ZIGBEE_AT_NO_MSG,
+        { { "AT_MODE", ZB_STARTUP_DEV_CHECK, ZB_MSG_NETWORK_CHECK, zigbee_startup_at_mode } } },
+    [ZB_STARTUP_SET_BAUD] = {
+        // The module confirms at the old rate, then switches. Only "ERROR" is a refusal:
+        // after a lost or stray reply it may have switched all the same.
+        "AT+BAUD=" ZIGBEE_STR(ZIGBEE_BAUD_FAST), 1000, 1, ZB_STARTUP_BAUD_FALLBACK, ZB_STARTUP_SET_BAUD,
+        ZB_MSG_BAUD_TIMEOUT, ZB_MSG_BAUD_FAIL,
+        { { "BAUD=" ZIGBEE_STR(ZIGBEE_BAUD_FAST), ZB_STARTUP_CHECK_BAUD, ZIGBEE_AT_NO_MSG, zigbee_startup_baud_switch },
+          { "ERROR", ZB_STARTUP_DEV_CHECK, ZB_MSG_BAUD_FAIL, zigbee_startup_baud_refused } } },
+    [ZB_STARTUP_CHECK_BAUD] = {
+        // Any doubt about the new rate falls back to the default one
+        "AT+DEV?", 500, 2, ZB_STARTUP_BAUD_FALLBACK, ZB_STARTUP_CHECK_BAUD,
+        ZB_MSG_DEV_TIMEOUT, ZB_MSG_DEV_NOT_OK,
+        { { "DEV=", ZB_STARTUP_NWK_CHECK, ZB_MSG_DEV_OK, zigbee_startup_baud_ok } } },
+    [ZB_STARTUP_VERIFY_ADDR] = {
+        // Any doubt about the saved parameters falls back to the full startup
+        "AT+ADDR?", 1000, 2, ZB_STARTUP_DEV_CHECK, ZB_STARTUP_VERIFY_ADDR,
+        ZB_MSG_ADDR_TIMEOUT, ZB_MSG_ADDR_FAIL,
+        { { "ADDR=", ZB_STARTUP_EXIT_AT, ZIGBEE_AT_NO_MSG, zigbee_startup_verify_addr } } },
+    [ZB_STARTUP_DEV_CHECK] = {
+        // A module that stays silent in AT mode may be at another rate than we think
+        // (a lost or late "BAUD=" reply): resetting it brings it back to the default one.
+        // NWK_CHECK gives up the same way.
+        "AT+DEV?", 1000, 5, ZB_STARTUP_RESET, ZB_STARTUP_DEV_CHECK,
+        ZB_MSG_DEV_TIMEOUT, ZB_MSG_DEV_NOT_OK,
+        { { "DEV=", ZB_STARTUP_NWK_CHECK, ZB_MSG_DEV_OK, NULL } } },
+    [ZB_STARTUP_NWK_CHECK] = {
+        "AT+NWK?", 1000, 5, ZB_STARTUP_RESET, ZB_STARTUP_NWK_CHECK,
+        ZB_MSG_NWK_TIMEOUT, ZB_MSG_NWK_UNEXPECTED,
+        { { "NWK=1", ZB_STARTUP_GET_ADDR, ZB_MSG_NWK_OK, zigbee_startup_nwk_online },
+          { "NWK=0", ZB_STARTUP_SET_CHANNEL, ZB_MSG_NWK_NOT_JOINED, zigbee_startup_nwk_not_joined },
+          { "NWK=2", ZB_STARTUP_SET_CHANNEL, ZB_MSG_NWK_OFFLINE, zigbee_startup_nwk_offline } } },
+    [ZB_STARTUP_SET_CHANNEL] = {
+        "AT+CH=11", 1000, ZIGBEE_AT_RETRY_FOREVER, ZB_STARTUP_SET_CHANNEL, ZB_STARTUP_SET_CHANNEL,
+        ZB_MSG_CH_TIMEOUT, ZB_MSG_CH_FAIL,
+        { { "CH=11", ZB_STARTUP_JOIN, ZB_MSG_CH_OK, NULL } } },
+    [ZB_STARTUP_JOIN] = {
+        "AT+JOIN", 5000, ZIGBEE_AT_RETRY_FOREVER, ZB_STARTUP_JOIN, ZB_STARTUP_NWK_CHECK,
+        ZB_MSG_JOIN_TIMEOUT, ZB_MSG_JOIN_FAIL,
+        { { "OK", ZB_STARTUP_NWK_CHECK, ZB_MSG_JOIN_OK, NULL } } },
+    [ZB_STARTUP_GET_ADDR] = {
+        "AT+ADDR?", 1000, ZIGBEE_AT_RETRY_FOREVER, ZB_STARTUP_GET_ADDR, ZB_STARTUP_GET_ADDR,
+        ZB_MSG_ADDR_TIMEOUT, ZB_MSG_ADDR_FAIL,
+        { { "ADDR=", ZB_STARTUP_SET_DSTADDR, ZIGBEE_AT_NO_MSG, zigbee_startup_store_addr } } },
+    [ZB_STARTUP_SET_DSTADDR] = {
+        "AT+DSTADDR=0x0000", 1000, ZIGBEE_AT_RETRY_FOREVER, ZB_STARTUP_SET_DSTADDR, ZB_STARTUP_SET_DSTADDR,
+        ZB_MSG_DSTADDR_TIMEOUT, ZB_MSG_DSTADDR_FAIL,
+        { { "DSTADDR=0x0000", ZB_STARTUP_SET_DSTEP, ZB_MSG_DSTADDR_OK, NULL } }, true },
+    [ZB_STARTUP_SET_DSTEP] = {
+        "AT+DSTEP=0x01", 1000, ZIGBEE_AT_RETRY_FOREVER, ZB_STARTUP_SET_DSTEP, ZB_STARTUP_SET_DSTEP,
+        ZB_MSG_DSTEP_TIMEOUT, ZB_MSG_DSTEP_FAIL,
+        { { "DSTEP=0x01", ZB_STARTUP_EXIT_AT, ZB_MSG_DSTEP_OK, NULL } }, true },
+    [ZB_STARTUP_EXIT_AT] = {
+        // A lost "OK" leaves the module in data mode, deaf to AT+EXIT: knock again with "+AT"
+        "AT+EXIT", 1000, 3, ZB_STARTUP_BEGIN, ZB_STARTUP_EXIT_AT,
+        ZB_MSG_EXIT_TIMEOUT, ZB_MSG_EXIT_FAIL,
+        { { "OK", ZB_STARTUP_DONE, ZB_MSG_EXIT_OK, NULL } } },
+    [ZB_STARTUP_LEAVE] = {
+        "AT+LEAVE", 1000, 1, ZB_STARTUP_RESTART, ZB_STARTUP_RESTART,
+        ZIGBEE_AT_NO_MSG, ZIGBEE_AT_NO_MSG,
+        { { "OK", ZB_STARTUP_RESTART, ZIGBEE_AT_NO_MSG, NULL } } },
+    // ZB_STARTUP_DONE, ZB_STARTUP_RESTART, ZB_STARTUP_RESET,
+    // ZB_STARTUP_NEXT_BAUD and ZB_STARTUP_BAUD_FALLBACK have no command: the engine stops there.
+    // SET_DSTADDR and SET_DSTEP do not depend on earlier replies, so they go out right
+    // behind AT+ADDR? instead of one round trip each.
+};
+
+// A reply split over two TX blocks would leave a gap in the slot between the two transfers
+_Static_assert(ZIGBEE_REPLY_MAX_FRAME <= UART1_TX_BLOCK_SIZE, "a slot reply must fit one USART1 TX block");
+
+static ZigbeeAt_t zigbee_startup;
+static uint32_t zigbee_startup_phase_ms[ZB_STARTUP_STEP_COUNT];
+static ZigbeeStoreData_t zigbee_saved; // Parameters from flash, valid while zigbee_saved_valid
+static bool zigbee_saved_valid = false;
+static bool zigbee_store_pending = false; // zigbee_saved still has to be written to flash
+static uint32_t zigbee_store_pending_tick = 0; // When zigbee_store_pending was set
+static SchedTimer_t zigbee_wakeup_timer; // Wakes the managers for timeouts and delays
+
+// Rates the module is probed at in turn, from the default one after a reset
+#if ZIGBEE_BAUD_FAST
+static const uint32_t zigbee_baud_rates[] = { ZIGBEE_BAUD_FAST, ZIGBEE_BAUD_DEFAULT };
+#else
+static const uint32_t zigbee_baud_rates[] = { ZIGBEE_BAUD_DEFAULT };
+#endif
+#define ZIGBEE_BAUD_RATE_COUNT (sizeof(zigbee_baud_rates) / sizeof(zigbee_baud_rates[0]))
+static uint8_t zigbee_baud_index = 0;
+static bool zigbee_baud_upgrade_failed = false; // Stay at the default rate until the next reset
+
+void zigbee_get_id_manager(const ZigbeeRxLine_t *line);
+static void zigbee_on_event(void);
 /* -------------------------- Private function prototypes ------------------------- */
-void HAL_UART_RxCpltCallback(UART_HandleTypeDef *huart);
+void HAL_UARTEx_RxEventCallback(UART_HandleTypeDef *huart, uint16_t Size);
+void HAL_UART_ErrorCallback(UART_HandleTypeDef *huart);
+static bool check_timer_timeout(uint32_t start_tick, uint32_t timeout_ms)
+{
+    return (HAL_GetTick() - start_tick > timeout_ms);
+}
+
+void zigbee_uart_data_send(const char *data)
+{
+    uart_tx_write(&huart1, (const uint8_t *)data, strlen(data));
+}
+
 /**
- * @brief Converts a single hexadecimal character to its integer value.
- * @param c The character ('0'-'9', 'a'-'f', 'A'-'F').
- * @return The integer value (0-15), or -1 on error.
+ * @brief Starts (or restarts) the circular DMA reception on USART1.
+ *        The DMA keeps filling rx_dma_buffer on its own; the CPU is only
+ *        interrupted on idle line, half transfer and transfer complete.
  */
-static int hex_char_to_int(char c)
+static void zigbee_rx_start(void)
 {
-    c = tolower(c);
-    if (c >= '0' && c <= '9') {
-        return c - '0';
-    }
-    if (c >= 'a' && c <= 'f') {
-        return c - 'a' + 10;
-    }
-    return -1;
+    rx_dma_read_pos = 0;
+    HAL_UARTEx_ReceiveToIdle_DMA(&huart1, rx_dma_buffer, RX_DMA_BUFFER_SIZE);
 }
 
 /**
- * @brief Decodes a hex string into a binary bitmap.
- * @param hex_str The null-terminated hex string (e.g., "a813").
- * @param bitmap  The output byte array to store the binary bitmap.
- * @param max_bitmap_size The size of the output bitmap buffer.
- * @return The number of bytes written to the bitmap.
+ * @brief Moves USART1 to another baud rate and restarts reception. Only called between
+ *        AT transactions; anything still queued for the module at the old rate is dropped.
+ * @param baud The new rate.
  */
-static int decode_hex_to_bitmap(const char* hex_str, uint8_t* bitmap, int max_bitmap_size)
+static void zigbee_link_set_baud(uint32_t baud)
 {
-    int hex_len = strlen(hex_str);
-    int byte_count = 0;
-    memset(bitmap, 0, max_bitmap_size); // Clear the bitmap first
-
-    // Process two hex characters at a time to form one byte
-    for (int i = 0; i < hex_len && (i + 1) < hex_len; i += 2) {
-        if (byte_count >= max_bitmap_size) break; // Prevent buffer overflow
-
-        int high_nibble = hex_char_to_int(hex_str[i]);
-        int low_nibble = hex_char_to_int(hex_str[i + 1]);
-
-        if (high_nibble != -1 && low_nibble != -1) {
-            bitmap[byte_count++] = (high_nibble << 4) | low_nibble;
+    HAL_UART_AbortReceive(&huart1);
+    if (huart1.Init.BaudRate != baud) {
+        uart_tx_abort(&huart1);
+        huart1.Init.BaudRate = baud;
+        if (HAL_UART_Init(&huart1) != HAL_OK) {
+            Error_Handler();
         }
     }
-    return byte_count;
+    rx_index = 0;
+    rx_line_discard = false;
+    zigbee_rx_start();
 }
 
 /**
- * @brief Checks if a device should respond and calculates its time slot.
- *
- * @param bitmap The decoded bitmap from the master.
- * @param max_bit The highest possible ID number represented in the bitmap.
- * @param self_id The ID of this device.
- * @return The time slot (0 for first, 1 for second, etc.), or -1 if the device should not respond.
+ * @brief Returns the oldest complete line without removing it from the queue.
+ * @return The line, or NULL if no complete line has been received.
  */
-static int get_response_slot(const uint8_t* bitmap, int max_bit, int self_id)
+static const ZigbeeRxLine_t *zigbee_rx_line_peek(void)
 {
-    if (self_id <= 0 || self_id > max_bit) {
-        return -1;
+    uint8_t tail = rx_line_tail;
+    if (tail == rx_line_head) {
+        return NULL;
     }
+    __DMB(); // Read the slot contents only after seeing the published head
+    return &rx_line_queue[tail & RX_LINE_QUEUE_MASK];
+}
 
-    // 1. First, check if our own ID is present in the bitmap.
-    int self_byte_index = (self_id - 1) / 8;
-    int self_bit_index = (self_id - 1) % 8;
-    if (!((bitmap[self_byte_index] >> self_bit_index) & 1)) {
-        return -1; // Our bit is not set, we should not respond.
+/**
+ * @brief Hands the oldest line slot back to the receive ISR.
+ */
+static void zigbee_rx_line_release(void)
+{
+    uint8_t tail = rx_line_tail;
+    if (tail == rx_line_head) {
+        return; // Queue was flushed by zigbee_init() while the line was being handled
     }
+    __DMB(); // Finish every read of the slot before the ISR may reuse it
+    rx_line_tail = tail + 1;
+}
+/**
+ * @brief Hashes the commands that configure the module, so parameters saved under
+ *        a different configuration are not reused.
+ */
+static uint32_t zigbee_config_hash(void)
+{
+    static const uint8_t config_steps[] = { ZB_STARTUP_SET_CHANNEL, ZB_STARTUP_SET_DSTADDR, ZB_STARTUP_SET_DSTEP };
+    uint32_t hash = ZIGBEE_STORE_HASH_INIT;
 
-    // 2. Our bit is set. Now, count how many devices with a LOWER ID are also set.
-    // This count determines our unique time slot for responding.
-    int preceding_slaves = 0;
-    for (int i = 1; i < self_id; i++) {
-        int byte_index = (i - 1) / 8;
-        int bit_index = (i - 1) % 8;
-        if ((bitmap[byte_index] >> bit_index) & 1) {
-            preceding_slaves++;
-        }
+    for (uint8_t i = 0; i < sizeof(config_steps); i++) {
+        const char *command = zigbee_startup_steps[config_steps[i]].command;
+        hash = zigbee_store_hash(command, strlen(command) + 1, hash);
     }
-
-    return preceding_slaves;
+    return hash;
 }
-void start_timer(void)
+
+/**
+ * @brief Picks the wait before the next rejoin attempt: ZIGBEE_REJOIN_BASE_MS doubled
+ *        per attempt up to ZIGBEE_REJOIN_CAP_MS, of which a random half is added as jitter.
+ *        The random sequence is seeded from the 96-bit chip UID, so nodes that lost the
+ *        coordinator together spread their rejoins instead of retrying in lockstep.
+ * @return The delay in milliseconds.
+ */
+static uint32_t zigbee_rejoin_delay_ms(void)
 {
-    state_enter_tick = HAL_GetTick();
+    uint32_t delay = ZIGBEE_REJOIN_CAP_MS;
+
+    if (rejoin_jitter_state == 0) {
+        uint32_t uid[3] = { HAL_GetUIDw0(), HAL_GetUIDw1(), HAL_GetUIDw2() };
+        rejoin_jitter_state = zigbee_store_hash(uid, sizeof(uid), ZIGBEE_STORE_HASH_INIT) | 1;
+    }
+    rejoin_jitter_state ^= rejoin_jitter_state << 13;
+    rejoin_jitter_state ^= rejoin_jitter_state >> 17;
+    rejoin_jitter_state ^= rejoin_jitter_state << 5;
+
+    if (rejoin_backoff < 16 && (ZIGBEE_REJOIN_BASE_MS << rejoin_backoff) < ZIGBEE_REJOIN_CAP_MS) {
+        delay = ZIGBEE_REJOIN_BASE_MS << rejoin_backoff;
+        rejoin_backoff++;
+    }
+    delay = delay / 2 + rejoin_jitter_state % (delay / 2 + 1);
+    ZB_LOG_INFO(ZB_MSG_REJOIN_BACKOFF, rejoin_backoff, delay);
+    return delay;
 }
 
-static bool check_timer_timeout(uint32_t start_tick, uint32_t timeout_ms)
+/**
+ * @brief Tells whether a reply field is all digits, so a bit flipped on the link is not
+ *        taken for an address or an ID.
+ * @param text The field, not null-terminated.
+ * @param len Its length, 0 is not a number.
+ * @param hex Hexadecimal digits are allowed too.
+ */
+static bool zigbee_is_number(const uint8_t *text, uint16_t len, bool hex)
 {
-    return (HAL_GetTick() - start_tick > timeout_ms);
+    if (len == 0) {
+        return false;
+    }
+    for (uint16_t i = 0; i < len; i++) {
+        if (!(hex ? isxdigit(text[i]) : isdigit(text[i]))) {
+            return false;
+        }
+    }
+    return true;
 }
 
-void zigbee_uart_data_send(char *data)
+/**
+ * @brief Takes on the ID the master assigned to us.
+ * @param id The ID digits, not null-terminated.
+ * @param len The number of digits, 1 to ZIGBEE_ID_MAX_DIGITS.
+ */
+static void zigbee_set_id(const uint8_t *id, uint8_t len)
 {
-    U1_printf(data);
+    memcpy((uint8_t *)zigbee_info.zigbee_id, id, len);
+    zigbee_info.zigbee_id[len] = '\0';
+    memcpy((uint8_t *)zigbee_info.zigbee_id_uart_data, id, len);
+    zigbee_info.zigbee_id_uart_data[len] = '\n';
+    zigbee_id_reply_len = len + 1;
+    zigbee_self_id = atoi((char *)zigbee_info.zigbee_id);
+    ZB_LOG_INFO(ZB_MSG_SELF_ID, zigbee_self_id);
 }
 
-void clear_buffer_reable_interrupt(void)
+/**
+ * @brief Writes zigbee_saved to flash now, see zigbee_store_flush() for when it is safe.
+ */
+static void zigbee_store_write(void)
 {
-    rx_index = 0;
-    memset(rx_buffer, 0, RX_BUFFER_SIZE);
-    data_ready = 0;
-    HAL_UART_Receive_IT(&huart1, &rx_data, 1);
+    zigbee_store_pending = false;
+    zigbee_saved_valid = zigbee_store_save(&zigbee_saved);
+    if (!zigbee_saved_valid) {
+        ZB_LOG_ERROR(ZB_MSG_STORE_FAILED);
+    }
 }
+
 void zigbee_init(void)
 {
     // set low PB9
     HAL_GPIO_WritePin(GPIOB, GPIO_PIN_9, GPIO_PIN_RESET);
     HAL_GPIO_WritePin(GPIOA, GPIO_PIN_0, GPIO_PIN_RESET);
     HAL_GPIO_WritePin(GPIOA, GPIO_PIN_0, GPIO_PIN_SET);
-    zigbee_startup_state = ZB_STARTUP_BEGIN;
+    zigbee_at_start(&zigbee_startup, zigbee_startup_steps, ZB_STARTUP_STEP_COUNT, zigbee_startup_phase_ms,
+                    ZB_STARTUP_BEGIN);
+    if (zigbee_store_pending) {
+        zigbee_store_write(); // The link is down for the reset anyway, and the load below needs it
+    }
+    zigbee_saved_valid = zigbee_store_load(&zigbee_saved) && zigbee_saved.config_hash == zigbee_config_hash();
     zigbee_init_info_state = ZB_INIT_INFO_GET_ID;
-    HAL_UART_Receive_IT(&huart1, &rx_data, 1);
-
-    // wait 2s for zigbee reset
-    HAL_Delay(2000);
-    zigbee_uart_data_send("+AT");
-    start_timer(); // MODIFIED: Start timer for the initial command
-    U2_printf("Starting...\r\n");
-}
-
-void zigbee_transmit_data_handle()
-{
-    if (data_ready) {
-        U2_printf("rx_buffer: %s\r\n", rx_buffer);
-
-        // Check for the new hex bitmap prefix "MBMP:"
-        if (strncmp((char *)rx_buffer, "MBMP:", 5) == 0) {
-            const char *hex_payload = (const char *)rx_buffer + 5;
-            
-            // Create a buffer to hold the decoded binary bitmap.
-            // Size 64 supports up to 512 slave IDs, adjust if needed.
-            uint8_t decoded_bitmap[64]; 
-            int bitmap_byte_count = decode_hex_to_bitmap(hex_payload, decoded_bitmap, sizeof(decoded_bitmap));
-
-            if (bitmap_byte_count > 0) {
-                // Convert our own ID from string to integer
-                int self_id = atoi((char*)zigbee_info.zigbee_id);
-
-                // Get our time slot (e.g., 0, 1, 2...)
-                int slot = get_response_slot(decoded_bitmap, bitmap_byte_count * 8, self_id);
-
-                // If slot is not -1, it means we must respond
-                if (slot != -1) {
-                    U2_printf("ID %d is present. Responding in slot %d.\r\n", self_id, slot);
-                    
-                    // Wait for our designated time slot to avoid collisions
-                    start_timer();
-                    while (!check_timer_timeout(state_enter_tick, ZIGBEE_INTERVAL_RESPONSE * slot)) {
-                        ; // Busy wait for the correct delay
-                    }
-
-                    // Send our ID back to the master
-                    zigbee_uart_data_send((char *)zigbee_info.zigbee_id_uart_data);
-                }
+    get_id_timeouts = 0;
+    zigbee_timer_cancel(); // A reply scheduled before the reset must not go out
+    HAL_UART_AbortReceive(&huart1);
+    rx_line_tail = rx_line_head;
+    // The reset brings the module back to its default rate, AT+BAUD= raises it again
+    zigbee_baud_index = ZIGBEE_BAUD_RATE_COUNT - 1;
+    zigbee_link_set_baud(zigbee_baud_rates[zigbee_baud_index]);
+
+    // No fixed wait for the reset: the BEGIN step keeps sending "+AT" until the module answers
+    ZB_LOG_INFO(ZB_MSG_STARTING);
+
+    scheduler_subscribe(SCHED_EVENT_RX_LINE, zigbee_on_event);
+    scheduler_subscribe(SCHED_EVENT_TX_DONE, zigbee_on_event);
+    scheduler_subscribe(SCHED_EVENT_ZIGBEE_TIMER, zigbee_on_event);
+    scheduler_post(SCHED_EVENT_ZIGBEE_TIMER);
+}
+
+/**
+ * @brief Sends our reply to the master: the frame of batched records if there is one, our
+ *        ID line otherwise. Runs from the TIM2 interrupt at the start of our slot. Nothing
+ *        else is sent on USART1 once the ID is known, so the DMA starts on the reply at once.
+ */
+static void zigbee_send_slot_reply(void)
+{
+    PROF_BEGIN(PROF_SLOT_TX);
+    if (zigbee_reply_frame_len != 0) {
+        if (uart_tx_write(&huart1, zigbee_reply_frame, zigbee_reply_frame_len)) {
+            zigbee_reply_commit();
+        }
+    } else {
+        uart_tx_write(&huart1, (const uint8_t *)zigbee_info.zigbee_id_uart_data, zigbee_id_reply_len);
+    }
+    latency_record((int32_t)(zigbee_timer_now_us() - zigbee_reply_due_us));
+    PROF_END(PROF_SLOT_TX);
+}
+
+/**
+ * @brief Returns the longest reply that still ends ZIGBEE_REPLY_GUARD_US before our slot does.
+ */
+static uint16_t zigbee_reply_budget(void)
+{
+    uint32_t char_us = ZIGBEE_UART_CHAR_BITS * 1000000u / huart1.Init.BaudRate;
+    uint32_t fit = (ZIGBEE_INTERVAL_RESPONSE_US - ZIGBEE_REPLY_GUARD_US) / char_us;
+
+    return (fit < ZIGBEE_REPLY_MAX_FRAME) ? (uint16_t)fit : ZIGBEE_REPLY_MAX_FRAME;
+}
+
+void zigbee_transmit_data_handle(const ZigbeeRxLine_t *line)
+{
+    if (line != NULL) {
+        // The slot was already worked out by the streaming parser while the poll was received.
+        // Hand the reply to the hardware timer, counted from the end of the poll, before any
+        // logging so the debug output cannot delay it.
+        if (line->mbmp_slot >= 0) {
+            PROF_BEGIN(PROF_SLOT_SCHEDULE);
+            // Pack the backlog into one frame; no earlier reply may fire while it is rebuilt
+            zigbee_timer_cancel();
+            zigbee_reply_frame_len = zigbee_reply_build((uint16_t)zigbee_self_id, zigbee_reply_budget(), zigbee_reply_frame);
+            zigbee_reply_due_us = line->end_us + (uint32_t)line->mbmp_slot * ZIGBEE_INTERVAL_RESPONSE_US;
+            zigbee_timer_schedule_at(zigbee_reply_due_us, zigbee_send_slot_reply);
+            PROF_END(PROF_SLOT_SCHEDULE);
+        }
+
+        if (line->len > 0 && line->data[0] == MBMP_FRAME_SYNC) {
+            ZB_LOG_DEBUG(ZB_MSG_RX_FRAME, line->data[1], line->len);
+        } else {
+            ZB_LOG_DEBUG_TEXT(ZB_MSG_RX_LINE, line->data, line->len);
+        }
+        if (line->mbmp_slot == MBMP_SLOT_MALFORMED) {
+            ZB_LOG_WARN(ZB_MSG_MBMP_MALFORMED);
+        } else if (line->mbmp_slot >= 0) {
+            ZB_LOG_DEBUG(ZB_MSG_SLOT_REPLY, zigbee_self_id, line->mbmp_slot);
+            if (zigbee_reply_frame_len != 0) {
+                ZB_LOG_DEBUG(ZB_MSG_REPLY_BATCH, zigbee_reply_frame_len, zigbee_reply_pending());
             }
         }
-        clear_buffer_reable_interrupt();
+        zigbee_rx_line_release();
     }
 }
 
 
+/**
+ * @brief Logs how long each startup step took and the time from reset to the end of startup.
+ */
+static void zigbee_startup_report(void)
+{
+    for (uint8_t step = 0; step < ZB_STARTUP_DONE; step++) {
+        if (zigbee_startup_phase_ms[step] != 0) {
+            ZB_LOG_INFO(ZB_MSG_STARTUP_PHASE, step, zigbee_startup_phase_ms[step]);
+        }
+    }
+    ZB_LOG_INFO(ZB_MSG_STARTUP_TIME, HAL_GetTick());
+}
+
 void zigbee_run(void)
 {
-    if (zigbee_startup_state != ZB_STARTUP_DONE) {
-        zigbee_network_init_manager();
+    // Oldest received line, if any. The manager that consumes it releases the slot.
+    const ZigbeeRxLine_t *line = zigbee_rx_line_peek();
+
+    if (zigbee_startup.step != ZB_STARTUP_DONE) {
+        if (zigbee_at_run(&zigbee_startup, (line != NULL) ? line->data : NULL, (line != NULL) ? line->len : 0)) {
+            zigbee_rx_line_release();
+        }
+        if (zigbee_startup.step == ZB_STARTUP_DONE) {
+            zigbee_startup_report();
+        } else if (zigbee_startup.step == ZB_STARTUP_RESTART) {
+            // Reset from here rather than from inside the step that asked for it
+            zigbee_init();
+            zigbee_at_delay(&zigbee_startup, zigbee_rejoin_delay_ms());
+        } else if (zigbee_startup.step == ZB_STARTUP_RESET) {
+            // Not a network problem, so the rejoin backoff is left alone
+            zigbee_init();
+            zigbee_at_delay(&zigbee_startup, ZIGBEE_RESET_DELAY_MS);
+        } else if (zigbee_startup.step == ZB_STARTUP_NEXT_BAUD) {
+            zigbee_baud_index = (zigbee_baud_index + 1) % ZIGBEE_BAUD_RATE_COUNT;
+            zigbee_link_set_baud(zigbee_baud_rates[zigbee_baud_index]);
+            ZB_LOG_DEBUG(ZB_MSG_BAUD_PROBE, zigbee_baud_rates[zigbee_baud_index]);
+            zigbee_at_goto(&zigbee_startup, ZB_STARTUP_BEGIN);
+        } else if (zigbee_startup.step == ZB_STARTUP_BAUD_FALLBACK) {
+            ZB_LOG_WARN(ZB_MSG_BAUD_FALLBACK, ZIGBEE_BAUD_FAST, ZIGBEE_BAUD_DEFAULT);
+            zigbee_baud_upgrade_failed = true;
+            // The module may have switched without us hearing it: reset it and probe again
+            zigbee_init();
+        }
     } else if (zigbee_init_info_state != ZB_INIT_INFO_GET_ID_DONE) {
-        zigbee_get_id_manager();
+        zigbee_get_id_manager(line);
     } else {
         // start serial receive and send logic
-        zigbee_transmit_data_handle();
+        zigbee_transmit_data_handle(line);
     }
 }
 
-void zigbee_get_id_manager(void)
+/**
+ * @brief Writes the parameters kept after GETID to flash, between polls: erasing a page
+ *        stalls the CPU for tens of milliseconds, receive interrupts and slot replies
+ *        included. Waits for ZIGBEE_STORE_QUIET_MS of link silence with no reply armed or
+ *        on the wire, but no longer than ZIGBEE_STORE_MAX_DEFER_MS.
+ */
+static void zigbee_store_flush(void)
 {
-    if (zigbee_init_info_state == ZB_INIT_INFO_GET_ID_DONE) {
+    uint32_t now = HAL_GetTick();
+
+    if (now - zigbee_store_pending_tick < ZIGBEE_STORE_MAX_DEFER_MS &&
+        (now - rx_last_tick < ZIGBEE_STORE_QUIET_MS || zigbee_timer_armed() || !uart_tx_idle())) {
         return;
     }
+    zigbee_store_write();
+}
 
+/**
+ * @brief Tells how soon the managers have something to do without a new line.
+ * @return Milliseconds until then, or 0 if they only wait for lines.
+ */
+static uint32_t zigbee_next_wakeup_ms(void)
+{
+    if (zigbee_startup.step != ZB_STARTUP_DONE) {
+        return zigbee_at_next_ms(&zigbee_startup);
+    }
+    if (zigbee_init_info_state == ZB_INIT_INFO_WAIT_ID_OK) {
+        uint32_t elapsed = HAL_GetTick() - get_id_sent_tick;
+        return (elapsed <= ZIGBEE_RESPONSE_TIMEOUT) ? ZIGBEE_RESPONSE_TIMEOUT - elapsed + 1 : 1;
+    }
+    if (zigbee_init_info_state == ZB_INIT_INFO_GET_ID) {
+        return 1;
+    }
+    if (zigbee_store_pending) {
+        // A reply armed or sending now brings a TX done event, this is the fallback
+        uint32_t quiet = HAL_GetTick() - rx_last_tick;
+        return (quiet < ZIGBEE_STORE_QUIET_MS) ? ZIGBEE_STORE_QUIET_MS - quiet : ZIGBEE_STORE_QUIET_MS;
+    }
+    return 0;
+}
+
+/**
+ * @brief Handler for RX line, TX done and wake-up timer events. Runs the managers
+ *        until they stop making progress, then arms the timer for their next deadline.
+ */
+static void zigbee_on_event(void)
+{
+    for (uint8_t i = 0; i < ZIGBEE_RUN_BURST; i++) {
+        uint8_t step = zigbee_startup.step;
+        bool waiting = zigbee_startup.waiting;
+        ZigbeeInitState_t info_state = zigbee_init_info_state;
+        uint8_t tail = rx_line_tail;
+
+        PROF_BEGIN(PROF_ZIGBEE_RUN);
+        zigbee_run();
+        PROF_END(PROF_ZIGBEE_RUN);
+
+        if (step == zigbee_startup.step && waiting == zigbee_startup.waiting &&
+            info_state == zigbee_init_info_state && tail == rx_line_tail) {
+            break;
+        }
+    }
+
+    if (zigbee_store_pending) {
+        zigbee_store_flush();
+    }
+
+    uint32_t overflows = rx_line_overflow_count;
+    if (overflows != rx_line_overflow_logged) {
+        ZB_LOG_WARN(ZB_MSG_RX_OVERFLOW, overflows - rx_line_overflow_logged, overflows);
+        rx_line_overflow_logged = overflows;
+    }
+
+    uint32_t next_ms = zigbee_next_wakeup_ms();
+    if (next_ms != 0) {
+        scheduler_timer_start(&zigbee_wakeup_timer, next_ms, SCHED_EVENT_ZIGBEE_TIMER);
+    } else {
+        scheduler_timer_stop(&zigbee_wakeup_timer);
+    }
+    if (zigbee_rx_line_peek() != NULL) {
+        scheduler_post(SCHED_EVENT_RX_LINE); // Out of burst, carry on after the other events
+    }
+}
+
+void zigbee_get_id_manager(const ZigbeeRxLine_t *line)
+{
     switch (zigbee_init_info_state) {
     case ZB_INIT_INFO_GET_ID:
-        zigbee_uart_data_send(zigbee_info.zigbee_addr);
-        U2_printf("Get ID: %s\r\n", zigbee_info.zigbee_addr);
+        // Only thread mode writes the request, it cannot change under us
+        zigbee_uart_data_send((const char *)zigbee_info.zigbee_addr);
+        ZB_LOG_INFO_TEXT(ZB_MSG_GET_ID, zigbee_info.zigbee_addr, strlen((const char *)zigbee_info.zigbee_addr));
         zigbee_init_info_state = ZB_INIT_INFO_WAIT_ID_OK;
-        start_timer();
+        get_id_sent_tick = HAL_GetTick();
         break;
 
     case ZB_INIT_INFO_WAIT_ID_OK:
-        if (check_timer_timeout(state_enter_tick, ZIGBEE_RESPONSE_TIMEOUT)) {
-            U2_printf("Get ID timeout, retrying\r\n");
+        if (check_timer_timeout(get_id_sent_tick, ZIGBEE_RESPONSE_TIMEOUT)) {
+            ZB_LOG_WARN(ZB_MSG_GET_ID_TIMEOUT);
             zigbee_init_info_state = ZB_INIT_INFO_GET_ID;
+            if (++get_id_timeouts >= ZIGBEE_GET_ID_MAX_TIMEOUTS) {
+                // The network may be gone, or our address misread: back to AT mode to check
+                // both, GETID goes out again once startup is through
+                get_id_timeouts = 0;
+                ZB_LOG_WARN(ZB_MSG_GET_ID_RECHECK);
+                zigbee_at_start(&zigbee_startup, zigbee_startup_steps, ZB_STARTUP_STEP_COUNT, zigbee_startup_phase_ms,
+                                ZB_STARTUP_BEGIN);
+                break;
+            }
         }
-        if (data_ready) {
-            if (strncmp((char *)rx_buffer, (char *)(zigbee_info.zigbee_addr + 6), 6) == 0) {
+        if (line != NULL) {
+            // Reply looks like "0x4653:03": our short address, ':' and the ID, two digits
+            // so far but up to ZIGBEE_ID_MAX_DIGITS in networks polled with ID lists
+            if (line->len > 7 && line->len <= 7 + ZIGBEE_ID_MAX_DIGITS &&
+                memcmp(line->data, (const uint8_t *)(zigbee_info.zigbee_addr + 6), 6) == 0 &&
+                line->data[6] == ':' && zigbee_is_number(line->data + 7, line->len - 7, false)) {
                 // 0x4653:03
-                U2_printf("Get ID OK: %s\r\n", rx_buffer);
-                memcpy(zigbee_info.zigbee_id, rx_buffer + 7, 2);
-                zigbee_info.zigbee_id[2] = '\0';
-                strcpy((char *)zigbee_info.zigbee_id_uart_data, (char *)zigbee_info.zigbee_id);
-                zigbee_info.zigbee_id_uart_data[2] = '\n';
-                U2_printf("ID: %s\r\n", zigbee_info.zigbee_id);
+                ZB_LOG_INFO_TEXT(ZB_MSG_GET_ID_OK, line->data, line->len);
+                get_id_timeouts = 0;
+                zigbee_set_id(line->data + 7, (uint8_t)(line->len - 7));
                 zigbee_init_info_state = ZB_INIT_INFO_GET_ID_DONE;
+
+                // Remember address and ID so the next boot can skip all of this
+                zigbee_saved.config_hash = zigbee_config_hash();
+                memcpy(zigbee_saved.addr, (const uint8_t *)zigbee_info.zigbee_addr, sizeof(zigbee_saved.addr));
+                memcpy(zigbee_saved.id, (const uint8_t *)zigbee_info.zigbee_id, sizeof(zigbee_saved.id));
+                // Written once the link is quiet, see zigbee_store_flush()
+                zigbee_saved_valid = true;
+                zigbee_store_pending = true;
+                zigbee_store_pending_tick = HAL_GetTick();
             } else {
-                U2_printf("Get ID fail: %s\r\n", rx_buffer);
+                ZB_LOG_WARN_TEXT(ZB_MSG_GET_ID_FAIL, line->data, line->len);
             }
-            clear_buffer_reable_interrupt();
+            zigbee_rx_line_release();
         }
         break;
+
+    case ZB_INIT_INFO_GET_ID_DONE:
+        break; // The ID is known, zigbee_run() hands the lines to the transmit handler
     }
 }
 
-void zigbee_network_init_manager(void)
+/**
+ * @brief Startup action for "AT_MODE": goes the short way when parameters were saved.
+ * @return The next startup step.
+ */
+static uint8_t zigbee_startup_at_mode(const uint8_t *data, uint16_t len)
 {
-    // If the process is finished or has failed, do nothing.
-    if (zigbee_startup_state == ZB_STARTUP_DONE || zigbee_startup_state == ZB_STARTUP_ERROR) {
-        return;
+    if (data != NULL) {
+        ZB_LOG_INFO(ZB_MSG_BAUD, huart1.Init.BaudRate);
+    }
+    if (ZIGBEE_BAUD_FAST != 0 && !zigbee_baud_upgrade_failed && huart1.Init.BaudRate != ZIGBEE_BAUD_FAST) {
+        return ZB_STARTUP_SET_BAUD;
     }
+    return zigbee_saved_valid ? ZB_STARTUP_VERIFY_ADDR : ZB_STARTUP_DEV_CHECK;
+}
 
-    // --- Main state machine logic ---
-    switch (zigbee_startup_state) {
+/**
+ * @brief Startup action for "BAUD=...": the module takes the faster rate once this reply
+ *        is out, so USART1 follows and the next command waits for it to settle.
+ * @return The next startup step.
+ */
+static uint8_t zigbee_startup_baud_switch(const uint8_t *data, uint16_t len)
+{
+    zigbee_link_set_baud(ZIGBEE_BAUD_FAST);
+    zigbee_at_delay(&zigbee_startup, ZIGBEE_BAUD_SETTLE_MS);
+    return ZB_STARTUP_CHECK_BAUD;
+}
 
-    case ZB_STARTUP_BEGIN:
-        // MODIFIED: Check for a timeout while waiting for the initial "AT_MODE" response.
-        if (check_timer_timeout(state_enter_tick, ZIGBEE_RESPONSE_TIMEOUT)) {
-            U2_printf("Timeout waiting for AT_MODE, retrying...\r\n");
-            zigbee_uart_data_send("+AT");
-            start_timer();
-        }
-        if (data_ready) {
-            U2_printf("Starting Zigbee network check...\r\n");
-            U2_printf("rx_buffer: %s\r\n", rx_buffer);
-            if (strncmp((char *)rx_buffer, "AT_MODE", 7) == 0) {
-                zigbee_startup_state = ZB_STARTUP_DEV_CHECK;
-            } else {
-                zigbee_uart_data_send("+AT");
-                start_timer(); // MODIFIED: Restart timer on retry
-            }
-            clear_buffer_reable_interrupt();
-        }
-        break;
+/**
+ * @brief Startup action for "ERROR" to AT+BAUD=: the module keeps the default rate, and
+ *        so do we until the next reset.
+ * @return The next startup step.
+ */
+static uint8_t zigbee_startup_baud_refused(const uint8_t *data, uint16_t len)
+{
+    zigbee_baud_upgrade_failed = true;
+    return zigbee_startup_at_mode(NULL, 0);
+}
 
-    case ZB_STARTUP_DEV_CHECK:
-        zigbee_uart_data_send("AT+DEV?"); // Send the device status query
-        start_timer();                   // MODIFIED: Start timer
-        zigbee_startup_state = ZB_STARTUP_WAIT_DEV_OK;
-        break;
-    case ZB_STARTUP_WAIT_DEV_OK:
-        // MODIFIED: Add timeout check for AT+DEV? response
-        if (check_timer_timeout(state_enter_tick, ZIGBEE_RESPONSE_TIMEOUT)) {
-            U2_printf("Timeout waiting for DEV status, retrying...\r\n");
-            zigbee_startup_state = ZB_STARTUP_DEV_CHECK;
-        }
-        if (data_ready) {
-            if (strncmp((char *)rx_buffer, "DEV=", 4) == 0) {
-                U2_printf("Device type detect OK: %s\r\n", rx_buffer);
-                zigbee_startup_state = ZB_STARTUP_SEND_NWK_CHECK;
-            } else {
-                U2_printf("Device type detect not OK, retrying...\r\n");
-                zigbee_startup_state = ZB_STARTUP_DEV_CHECK;
-            }
-            clear_buffer_reable_interrupt();
-        }
-        break;
-    
-    case ZB_STARTUP_SEND_NWK_CHECK:
-        zigbee_uart_data_send("AT+NWK?"); // Send the network status query
-        start_timer();                   // MODIFIED: Start timer
-        zigbee_startup_state = ZB_STARTUP_WAIT_NWK_STATUS;
-        break;
+/**
+ * @brief Startup action for "DEV=" at the new rate: the link works.
+ * @return The next startup step.
+ */
+static uint8_t zigbee_startup_baud_ok(const uint8_t *data, uint16_t len)
+{
+    ZB_LOG_INFO(ZB_MSG_BAUD, huart1.Init.BaudRate);
+    return zigbee_saved_valid ? ZB_STARTUP_VERIFY_ADDR : ZB_STARTUP_NWK_CHECK;
+}
 
-    case ZB_STARTUP_WAIT_NWK_STATUS:
-        // MODIFIED: Add timeout check for AT+NWK? response
-        if (check_timer_timeout(state_enter_tick, ZIGBEE_RESPONSE_TIMEOUT)) {
-            U2_printf("Timeout waiting for NWK status, retrying...\r\n");
-            zigbee_startup_state = ZB_STARTUP_SEND_NWK_CHECK;
-        }
-        if (data_ready) {
-            if (strncmp((char *)rx_buffer, "NWK=1", 5) == 0) {
-                U2_printf("Network status OK. Startup complete.\r\n");
-                zigbee_startup_state = ZB_STARTUP_GET_ADDR;
-            } else if (strncmp((char *)rx_buffer, "NWK=0", 5) == 0) {
-                U2_printf("Not in a network. Attempting to join...\r\n");
-                zigbee_startup_state = ZB_STARTUP_SET_CHANNEL;
-            } else if (strncmp((char *)rx_buffer, "NWK=2", 5) == 0) {
-                U2_printf("Network offline, redetect\r\n");
-                HAL_Delay(5000);
-                rejoin_detect++;
-							  zigbee_startup_state = ZB_STARTUP_SET_CHANNEL;
-                if (rejoin_detect > ZIGBEE_MAX_NETWORK_RETRY) {
-                   zigbee_uart_data_send("AT+LEAVE");
-                   U2_printf("Leave network for rejoin\r\n");
-                   zigbee_init();
-                   HAL_Delay(1000);
-                }
-                
-            } else {
-							
-                U2_printf("Error: Unexpected response to AT+NWK?: %s\r\n", rx_buffer);
-                zigbee_startup_state = ZB_STARTUP_SEND_NWK_CHECK;
-            }
-            clear_buffer_reable_interrupt();
-        }
-        break;
+/**
+ * @brief Startup action for "ADDR=0x...." on a warm boot. The same address as when the
+ *        parameters were saved means the module is still in that network, so the saved
+ *        ID is taken and the rest of the handshake, GETID included, is skipped.
+ * @return The next startup step.
+ */
+static uint8_t zigbee_startup_verify_addr(const uint8_t *data, uint16_t len)
+{
+    uint8_t next = zigbee_startup_store_addr(data, len);
+    if (next == ZB_STARTUP_GET_ADDR) {
+        return ZB_STARTUP_DEV_CHECK; // Garbled, the full startup asks for it again
+    }
+    if (next != ZB_STARTUP_SET_DSTADDR) {
+        return next; // Out of the network, the full startup rejoins
+    }
+    if (memcmp((const uint8_t *)zigbee_info.zigbee_addr, zigbee_saved.addr, sizeof(zigbee_saved.addr)) != 0) {
+        ZB_LOG_WARN(ZB_MSG_STORE_STALE);
+        zigbee_saved_valid = false;
+        return ZB_STARTUP_DEV_CHECK;
+    }
+    const uint8_t *id_end = memchr(zigbee_saved.id, '\0', sizeof(zigbee_saved.id));
+    zigbee_set_id(zigbee_saved.id, (uint8_t)((id_end != NULL) ? id_end - zigbee_saved.id : sizeof(zigbee_saved.id)));
+    zigbee_init_info_state = ZB_INIT_INFO_GET_ID_DONE;
+    ZB_LOG_INFO(ZB_MSG_WARM_BOOT);
+    return ZB_STARTUP_EXIT_AT;
+}
 
-    case ZB_STARTUP_SEND_JOIN:
-        zigbee_uart_data_send("AT+JOIN"); // Send the join command
-        start_timer();                    // MODIFIED: Start timer
-        zigbee_startup_state = ZB_STARTUP_WAIT_JOIN_OK;
-        break;
+/**
+ * @brief Startup action for "ADDR=0x....": keeps the GETID request built from our address.
+ *        A garbled address, or one that is not ZIGBEE_ADDR_DIGITS long, is asked for again.
+ * @return The next startup step.
+ */
+static uint8_t zigbee_startup_store_addr(const uint8_t *data, uint16_t len)
+{
+    static const char unassigned[] = "FFFE";
+    bool offline = true;
+
+    // Short addresses are 16-bit: anything longer would not fit the GETID request
+    if (len != 7 + ZIGBEE_ADDR_DIGITS || memcmp(data + 5, "0x", 2) != 0 ||
+        !zigbee_is_number(data + 7, ZIGBEE_ADDR_DIGITS, true)) {
+        ZB_LOG_WARN(ZB_MSG_ADDR_FAIL);
+        return ZB_STARTUP_GET_ADDR;
+    }
+    // 0xFFFE is no address at all: the network went away since NWK=1
+    for (uint8_t i = 0; offline && i < sizeof(unassigned) - 1; i++) {
+        offline = (toupper(data[7 + i]) == unassigned[i]);
+    }
+    if (offline) {
+        ZB_LOG_WARN(ZB_MSG_NWK_OFFLINE);
+        return ZB_STARTUP_NWK_CHECK;
+    }
+    snprintf((char *)zigbee_info.zigbee_addr, sizeof(zigbee_info.zigbee_addr), "GETID:%.*s\r\n",
+             (int)(len - 5), (const char *)(data + 5));
+    ZB_LOG_INFO_TEXT(ZB_MSG_ADDR, zigbee_info.zigbee_addr, strlen((const char *)zigbee_info.zigbee_addr));
+    return ZB_STARTUP_SET_DSTADDR;
+}
 
-    case ZB_STARTUP_WAIT_JOIN_OK:
-        // MODIFIED: Add timeout check for AT+JOIN response
-        if (check_timer_timeout(state_enter_tick, ZIGBEE_RESPONSE_TIMEOUT)) {
-            U2_printf("Timeout waiting for JOIN OK, retrying...\r\n");
-            zigbee_startup_state = ZB_STARTUP_SEND_JOIN;
-        }
-        if (data_ready) {
-            if (strncmp((char *)rx_buffer, "OK", 2) == 0) {
-                U2_printf("Join command accepted. Waiting for network connection...\r\n");
-                zigbee_startup_state = ZB_STARTUP_SEND_NWK_CHECK;
-            } else {
-                U2_printf("Error: AT+JOIN command failed.\r\n");
-                zigbee_startup_state = ZB_STARTUP_SEND_NWK_CHECK;
-            }
-            clear_buffer_reable_interrupt();
-        }
-        break;
+/**
+ * @brief Startup action for "NWK=1": we are in a network, rejoin backoff starts over.
+ * @return The next startup step.
+ */
+static uint8_t zigbee_startup_nwk_online(const uint8_t *data, uint16_t len)
+{
+    rejoin_detect = 0;
+    rejoin_backoff = 0;
+    join_sent = false;
+    return ZB_STARTUP_GET_ADDR;
+}
 
-    case ZB_STARTUP_DONE:
-        U2_printf("Zigbee network init complete.\r\n");
-        break;
+/**
+ * @brief Startup action for "NWK=2": the module lost its network. Rejoins after a
+ *        backoff, without blocking, and after ZIGBEE_MAX_NETWORK_RETRY attempts leaves
+ *        the network and starts over.
+ * @return The next startup step.
+ */
+static uint8_t zigbee_startup_nwk_offline(const uint8_t *data, uint16_t len)
+{
+    rejoin_detect++;
+    if (rejoin_detect > ZIGBEE_MAX_NETWORK_RETRY) {
+        rejoin_detect = 0;
+        ZB_LOG_WARN(ZB_MSG_NWK_LEAVE);
+        return ZB_STARTUP_LEAVE;
+    }
+    zigbee_at_delay(&zigbee_startup, zigbee_rejoin_delay_ms());
+    return ZB_STARTUP_SET_CHANNEL;
+}
 
-    case ZB_STARTUP_EXIT_AT:
-        zigbee_uart_data_send("AT+EXIT");
-        start_timer(); // MODIFIED: Start timer
-        zigbee_startup_state = ZB_STARTUP_WAIT_EXIT_OK;
-        break;
+/**
+ * @brief Startup action for "NWK=0": we are in no network. Joins at once the first time,
+ *        and after the rejoin backoff when a join did not get us in, not to flood the
+ *        coordinator with joins while it is busy or away.
+ * @return The next startup step.
+ */
+static uint8_t zigbee_startup_nwk_not_joined(const uint8_t *data, uint16_t len)
+{
+    if (join_sent) {
+        zigbee_at_delay(&zigbee_startup, zigbee_rejoin_delay_ms());
+    }
+    join_sent = true;
+    return ZB_STARTUP_SET_CHANNEL;
+}
 
-    case ZB_STARTUP_WAIT_EXIT_OK:
-        // MODIFIED: Add timeout check for AT+EXIT response
-        if (check_timer_timeout(state_enter_tick, ZIGBEE_RESPONSE_TIMEOUT)) {
-            U2_printf("Timeout waiting for EXIT OK, retrying...\r\n");
-            zigbee_startup_state = ZB_STARTUP_EXIT_AT;
-        }
-        if (data_ready) {
-            if (strncmp((char *)rx_buffer, "OK", 2) == 0) {
-                U2_printf("AT+EXIT finish.\r\n");
-                zigbee_startup_state = ZB_STARTUP_DONE;
-            } else {
-                U2_printf("Error: AT+EXIT command failed.\r\n");
-                zigbee_startup_state = ZB_STARTUP_EXIT_AT;
-            }
-            clear_buffer_reable_interrupt();
+/**
+ * @brief Appends one received byte to the line being assembled and publishes the
+ *        line to the queue on '\n'. Runs in interrupt context only.
+ *        When the queue is full the whole incoming line is dropped and counted.
+ * @param byte The received byte.
+ * @param byte_us When the byte finished arriving, in zigbee_timer_now_us() time.
+ */
+static void zigbee_rx_push_byte(uint8_t byte, uint32_t byte_us)
+{
+    uint8_t head = rx_line_head;
+
+    if (rx_index == 0 && !rx_line_discard) {
+        mbmp_stream_begin(&rx_mbmp_stream, zigbee_self_id);
+        // Start of a new line: we need a free slot to assemble it in.
+        if ((uint8_t)(head - rx_line_tail) >= RX_LINE_QUEUE_DEPTH) {
+            rx_line_overflow_count++;
+            rx_line_discard = true;
         }
-        break;
-    case ZB_STARTUP_GET_ADDR:
-        zigbee_uart_data_send("AT+ADDR?");
-        start_timer(); // MODIFIED: Start timer
-        zigbee_startup_state = ZB_STARTUP_WAIT_ADDR_OK;
-        break;
+    }
 
-    case ZB_STARTUP_WAIT_ADDR_OK:
-        // MODIFIED: Add timeout check for AT+ADDR? response
-        if (check_timer_timeout(state_enter_tick, ZIGBEE_RESPONSE_TIMEOUT)) {
-            U2_printf("Timeout waiting for ADDR, retrying...\r\n");
-            zigbee_startup_state = ZB_STARTUP_GET_ADDR;
-        }
-        if (data_ready) {
-            if (strncmp((char *)rx_buffer, "ADDR=", 5) == 0) {
-                sprintf((char *)zigbee_info.zigbee_addr, "GETID:%s\r\n", (char *)(rx_buffer + 5));
-                U2_printf("%s\r\n", rx_buffer);
-                zigbee_startup_state = ZB_STARTUP_SET_DSTADDR;
-                U2_printf("ADDR: %s\r\n", zigbee_info.zigbee_addr);
-            } else {
-                U2_printf("Error: AT+ADDR command failed., rx_buffer: %s\r\n", rx_buffer);
-                zigbee_startup_state = ZB_STARTUP_GET_ADDR;
-            }
-            clear_buffer_reable_interrupt();
+    if (rx_line_discard) {
+        // A binary frame has no '\n', the parser alone knows where it ends
+        if (rx_mbmp_stream.frame) {
+            mbmp_stream_feed(&rx_mbmp_stream, byte);
+            rx_line_discard = !mbmp_stream_frame_complete(&rx_mbmp_stream);
+        } else if (byte == '\n') {
+            rx_line_discard = false;
+        } else {
+            mbmp_stream_feed(&rx_mbmp_stream, byte);
         }
-        break;
+        return;
+    }
 
-    case ZB_STARTUP_SET_DSTADDR:
-        zigbee_uart_data_send("AT+DSTADDR=0x0000");
-        start_timer(); // MODIFIED: Start timer
-        zigbee_startup_state = ZB_STARTUP_WAIT_DSTADDR_OK;
-        break;
+    ZigbeeRxLine_t *slot = &rx_line_queue[head & RX_LINE_QUEUE_MASK];
 
-    case ZB_STARTUP_WAIT_DSTADDR_OK:
-        // MODIFIED: Add timeout check for AT+DSTADDR response
-        if (check_timer_timeout(state_enter_tick, ZIGBEE_RESPONSE_TIMEOUT)) {
-            U2_printf("Timeout setting DSTADDR, retrying...\r\n");
-            zigbee_startup_state = ZB_STARTUP_SET_DSTADDR;
+    // A newline ('\n') ends a text line; a binary frame may contain any byte and ends
+    // once the parser has seen its length and CRC
+    if (byte != '\n' || rx_mbmp_stream.frame) {
+        // Ensure we don't overflow the slot, drop lines that are too long
+        if (rx_index >= RX_LINE_MAX_LEN) {
+            rx_index = 0;
+            rx_line_discard = true;
+            return;
         }
-        if (data_ready) {
-            if (strncmp((char *)rx_buffer, "DSTADDR=0x0000", 14) == 0) {
-                U2_printf("AT+DSTADDR command accepted.\r\n");
-                zigbee_startup_state = ZB_STARTUP_SET_DSTEP;
-            } else {
-                U2_printf("Error: AT+DSTADDR command failed.\r\n");
-                zigbee_startup_state = ZB_STARTUP_SET_DSTADDR;
-            }
-            clear_buffer_reable_interrupt();
+        slot->data[rx_index++] = byte; // Store the received byte
+        mbmp_stream_feed(&rx_mbmp_stream, byte);
+    }
+    if (rx_mbmp_stream.frame ? mbmp_stream_frame_complete(&rx_mbmp_stream) : byte == '\n') {
+        uint16_t len = rx_index;
+        if (!rx_mbmp_stream.frame && len > 0 && slot->data[len - 1] == '\r') {
+            len--; // The length, not a terminator, marks the end of the line
         }
-        break;
-
-    case ZB_STARTUP_SET_DSTEP:
-        zigbee_uart_data_send("AT+DSTEP=0x01");
-        start_timer(); // MODIFIED: Start timer
-        zigbee_startup_state = ZB_STARTUP_WAIT_DSTEP_OK;
-        break;
+        slot->len = len;
+        slot->mbmp_slot = (int16_t)mbmp_stream_end(&rx_mbmp_stream);
+        slot->end_us = byte_us;
+        rx_index = 0;
+        __DMB(); // The slot must be complete before the main loop can see it
+        rx_line_head = head + 1;
+        scheduler_post(SCHED_EVENT_RX_LINE);
+    }
+}
 
-    case ZB_STARTUP_WAIT_DSTEP_OK:
-        // MODIFIED: Add timeout check for AT+DSTEP response
-        if (check_timer_timeout(state_enter_tick, ZIGBEE_RESPONSE_TIMEOUT)) {
-            U2_printf("Timeout setting DSTEP, retrying...\r\n");
-            zigbee_startup_state = ZB_STARTUP_SET_DSTEP;
+/**
+ * @brief Called by the HAL on idle line, DMA half transfer and DMA transfer complete.
+ * @param huart The UART handle.
+ * @param Size  Current write position of the DMA inside rx_dma_buffer.
+ */
+void HAL_UARTEx_RxEventCallback(UART_HandleTypeDef *huart, uint16_t Size)
+{
+    if (huart->Instance == USART1) // Check if the event is from the correct UART
+    {
+        PROF_BEGIN(PROF_RX_PARSE);
+        uint16_t pos = rx_dma_read_pos;
+        uint16_t count = (Size >= pos) ? (Size - pos) : (Size + RX_DMA_BUFFER_SIZE - pos);
+        uint32_t char_us = ZIGBEE_UART_CHAR_BITS * 1000000u / huart->Init.BaudRate;
+
+        // The bytes came in back to back, the last one just now, or one character time
+        // before an idle line event. Work back from there to time-stamp each of them.
+        uint32_t byte_us = zigbee_timer_now_us();
+        if (HAL_UARTEx_GetRxEventType(huart) == HAL_UART_RXEVENT_IDLE) {
+            byte_us -= char_us;
         }
-        if (data_ready) {
-            if (strncmp((char *)rx_buffer, "DSTEP=0x01", 10) == 0) {
-                U2_printf("AT+DSTEP command accepted.\r\n");
-                zigbee_startup_state = ZB_STARTUP_EXIT_AT;
-            } else {
-                U2_printf("Error: AT+DSTEP command failed.\r\n");
-                zigbee_startup_state = ZB_STARTUP_SET_DSTEP;
-            }
-            clear_buffer_reable_interrupt();
+        if (count > 0) {
+            byte_us -= (uint32_t)(count - 1) * char_us;
+            rx_last_tick = HAL_GetTick();
         }
-        break;
 
-    case ZB_STARTUP_SET_CHANNEL:
-        zigbee_uart_data_send("AT+CH=11");
-        start_timer(); // MODIFIED: Start timer
-        zigbee_startup_state = ZB_STARTUP_WAIT_CHANNEL_OK;
-        break;
-    case ZB_STARTUP_WAIT_CHANNEL_OK:
-        // MODIFIED: Add timeout check for AT+CH response
-        if (check_timer_timeout(state_enter_tick, ZIGBEE_RESPONSE_TIMEOUT)) {
-            U2_printf("Timeout setting CH, retrying...\r\n");
-            zigbee_startup_state = ZB_STARTUP_SET_CHANNEL;
-        }
-        if (data_ready) {
-            if (strncmp((char *)rx_buffer, "CH=11", 5) == 0) {
-                U2_printf("AT+CH command accepted.\r\n");
-                zigbee_startup_state = ZB_STARTUP_SEND_JOIN;
-            } else {
-                U2_printf("rx_buffer: %s\r\n", rx_buffer);
-                U2_printf("Error: AT+CH command failed.\r\n");
-                zigbee_startup_state = ZB_STARTUP_SET_CHANNEL;
+        // Consume everything the DMA has written since the last event
+        while (count--) {
+            zigbee_rx_push_byte(rx_dma_buffer[pos], byte_us);
+            byte_us += char_us;
+            if (++pos >= RX_DMA_BUFFER_SIZE) {
+                pos = 0;
             }
-            clear_buffer_reable_interrupt();
         }
-        break;
-    default:
-        break;
+        rx_dma_read_pos = (Size >= RX_DMA_BUFFER_SIZE) ? 0 : Size;
+        PROF_END(PROF_RX_PARSE);
     }
 }
 
-void HAL_UART_RxCpltCallback(UART_HandleTypeDef *huart)
+/**
+ * @brief Restarts the DMA reception after an overrun, noise or framing error.
+ * @param huart The UART handle.
+ */
+void HAL_UART_ErrorCallback(UART_HandleTypeDef *huart)
 {
-    if (huart->Instance == USART1) // Check if the interrupt is from the correct UART
+    if (huart->Instance == USART1)
     {
-        // Ensure we don't overflow the buffer, leave one byte for the null terminator
-        if (rx_index < RX_BUFFER_SIZE - 1) {
-            rx_buffer[rx_index++] = rx_data; // Store the received byte
-
-            // Check if the received character is a newline ('\n')
-            if (rx_data == '\n') {
-                rx_buffer[rx_index] = '\0'; // Null-terminate the string
-                data_ready = 1;             // Set flag for the main loop to process
-            } else {
-                // If not the end of the line, re-arm the interrupt to get the next byte
-                HAL_UART_Receive_IT(&huart1, &rx_data, 1);
-            }
-        } else {
-            // Buffer is full, reset to prevent errors
-            rx_index = 0;
-            HAL_UART_Receive_IT(&huart1, &rx_data, 1);
-        }
+        // Throw away the partial line, its missing bytes cannot be recovered
+        rx_index = 0;
+        rx_line_discard = false;
+        zigbee_rx_start();
     }
-}
\ No newline at end of file
+    else if (huart->Instance == USART2)
+    {
+        console_rx_error();
+    }
+}
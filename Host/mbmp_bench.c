@@ -0,0 +1,445 @@
+/**
+ * Host-side microbenchmark: table-driven mbmp_decode_hex() against the
+ * original strlen/memset/tolower decoder it replaced, and the word-wise
+ * mbmp_get_response_slot() against the original bit-by-bit scan, and the
+ * streaming parser against decode-then-count, and the binary frames against
+ * the hex line they replace, and the ID list search against a linear count.
+ *
+ * Build and run from this directory:
+ *   gcc -O2 -I../Core/Inc mbmp_bench.c ../Core/Src/mbmp.c -o mbmp_bench && ./mbmp_bench
+ */
+#include "mbmp.h"
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define BENCH_ITERATIONS 2000000
+
+/* ----------------------------- Reference decoder ----------------------------- */
+
+static int legacy_hex_char_to_int(char c)
+{
+    c = tolower(c);
+    if (c >= '0' && c <= '9') {
+        return c - '0';
+    }
+    if (c >= 'a' && c <= 'f') {
+        return c - 'a' + 10;
+    }
+    return -1;
+}
+
+static int legacy_decode_hex_to_bitmap(const char *hex_str, uint8_t *bitmap, int max_bitmap_size)
+{
+    int hex_len = strlen(hex_str);
+    int byte_count = 0;
+    memset(bitmap, 0, max_bitmap_size);
+
+    for (int i = 0; i < hex_len && (i + 1) < hex_len; i += 2) {
+        if (byte_count >= max_bitmap_size) break;
+
+        int high_nibble = legacy_hex_char_to_int(hex_str[i]);
+        int low_nibble = legacy_hex_char_to_int(hex_str[i + 1]);
+
+        if (high_nibble != -1 && low_nibble != -1) {
+            bitmap[byte_count++] = (high_nibble << 4) | low_nibble;
+        }
+    }
+    return byte_count;
+}
+
+static int legacy_get_response_slot(const uint8_t *bitmap, int max_bit, int self_id)
+{
+    if (self_id <= 0 || self_id > max_bit) {
+        return -1;
+    }
+
+    int self_byte_index = (self_id - 1) / 8;
+    int self_bit_index = (self_id - 1) % 8;
+    if (!((bitmap[self_byte_index] >> self_bit_index) & 1)) {
+        return -1;
+    }
+
+    int preceding_slaves = 0;
+    for (int i = 1; i < self_id; i++) {
+        int byte_index = (i - 1) / 8;
+        int bit_index = (i - 1) % 8;
+        if ((bitmap[byte_index] >> bit_index) & 1) {
+            preceding_slaves++;
+        }
+    }
+
+    return preceding_slaves;
+}
+
+/* ---------------------------------- Harness ---------------------------------- */
+
+static double now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+}
+
+static void bench(int hex_len)
+{
+    static const char digits[] = "0123456789abcdefABCDEF";
+    char hex[2 * MBMP_MAX_BITMAP_SIZE + 1];
+    uint8_t bitmap_ref[MBMP_MAX_BITMAP_SIZE];
+    uint8_t bitmap_new[MBMP_MAX_BITMAP_SIZE];
+    volatile int sink = 0;
+
+    for (int i = 0; i < hex_len; i++) {
+        hex[i] = digits[rand() % (sizeof(digits) - 1)];
+    }
+    hex[hex_len] = '\0';
+
+    // Both decoders must agree before their timings mean anything
+    int ref_count = legacy_decode_hex_to_bitmap(hex, bitmap_ref, sizeof(bitmap_ref));
+    int new_count = mbmp_decode_hex((const uint8_t *)hex, hex_len, bitmap_new, sizeof(bitmap_new));
+    if (ref_count != new_count || memcmp(bitmap_ref, bitmap_new, new_count) != 0) {
+        printf("MISMATCH at %d hex chars\n", hex_len);
+        exit(1);
+    }
+
+    double t0 = now_ns();
+    for (int i = 0; i < BENCH_ITERATIONS; i++) {
+        sink += legacy_decode_hex_to_bitmap(hex, bitmap_ref, sizeof(bitmap_ref));
+    }
+    double t1 = now_ns();
+    for (int i = 0; i < BENCH_ITERATIONS; i++) {
+        sink += mbmp_decode_hex((const uint8_t *)hex, hex_len, bitmap_new, sizeof(bitmap_new));
+    }
+    double t2 = now_ns();
+
+    double legacy_ns = (t1 - t0) / BENCH_ITERATIONS;
+    double lut_ns = (t2 - t1) / BENCH_ITERATIONS;
+    printf("%4d hex chars: legacy %8.1f ns  lut %8.1f ns  speedup %5.2fx\n",
+           hex_len, legacy_ns, lut_ns, legacy_ns / lut_ns);
+    (void)sink;
+}
+
+static void bench_slot(int self_id)
+{
+    uint8_t bitmap[MBMP_MAX_BITMAP_SIZE];
+    int max_bit = MBMP_MAX_BITMAP_SIZE * 8;
+    volatile int sink = 0;
+
+    for (int i = 0; i < MBMP_MAX_BITMAP_SIZE; i++) {
+        bitmap[i] = (uint8_t)rand();
+    }
+    bitmap[(self_id - 1) / 8] |= (uint8_t)(1u << ((self_id - 1) % 8));
+
+    // Every ID must land in the same slot with both implementations
+    for (int id = 1; id <= max_bit; id++) {
+        if (legacy_get_response_slot(bitmap, max_bit, id) != mbmp_get_response_slot(bitmap, max_bit, id)) {
+            printf("SLOT MISMATCH for ID %d\n", id);
+            exit(1);
+        }
+    }
+
+    double t0 = now_ns();
+    for (int i = 0; i < BENCH_ITERATIONS; i++) {
+        sink += legacy_get_response_slot(bitmap, max_bit, self_id);
+    }
+    double t1 = now_ns();
+    for (int i = 0; i < BENCH_ITERATIONS; i++) {
+        sink += mbmp_get_response_slot(bitmap, max_bit, self_id);
+    }
+    double t2 = now_ns();
+
+    double legacy_ns = (t1 - t0) / BENCH_ITERATIONS;
+    double swar_ns = (t2 - t1) / BENCH_ITERATIONS;
+    printf("slot for ID %3d: legacy %8.1f ns  swar %8.1f ns  speedup %5.2fx\n",
+           self_id, legacy_ns, swar_ns, legacy_ns / swar_ns);
+    (void)sink;
+}
+
+static int stream_line(const char *line, int self_id)
+{
+    MbmpStream_t stream;
+
+    mbmp_stream_begin(&stream, self_id);
+    for (const char *c = line; *c != '\0'; c++) {
+        mbmp_stream_feed(&stream, (uint8_t)*c);
+    }
+    return mbmp_stream_end(&stream);
+}
+
+static void bench_stream(int hex_len, int self_id)
+{
+    static const char digits[] = "0123456789abcdef";
+    char line[5 + 2 * MBMP_MAX_BITMAP_SIZE + 3] = "MBMP:";
+    uint8_t bitmap[MBMP_MAX_BITMAP_SIZE];
+    volatile int sink = 0;
+
+    for (int i = 0; i < hex_len; i++) {
+        line[5 + i] = digits[rand() % 16];
+    }
+    strcpy(line + 5 + hex_len, "\r");
+
+    // The streaming result must match decoding the whole line and then counting
+    for (int id = 1; id <= MBMP_MAX_BITMAP_SIZE * 8; id++) {
+        int count = mbmp_decode_hex((const uint8_t *)line + 5, hex_len, bitmap, sizeof(bitmap));
+        int slot = mbmp_get_response_slot(bitmap, count * 8, id);
+        if (stream_line(line, id) != slot) {
+            printf("STREAM MISMATCH for ID %d\n", id);
+            exit(1);
+        }
+    }
+
+    double t0 = now_ns();
+    for (int i = 0; i < BENCH_ITERATIONS; i++) {
+        int count = mbmp_decode_hex((const uint8_t *)line + 5, hex_len, bitmap, sizeof(bitmap));
+        sink += mbmp_get_response_slot(bitmap, count * 8, self_id);
+    }
+    double t1 = now_ns();
+    for (int i = 0; i < BENCH_ITERATIONS; i++) {
+        sink += stream_line(line, self_id);
+    }
+    double t2 = now_ns();
+
+    // The stream cost is spread over the byte arrivals; only its end is on the critical path
+    MbmpStream_t fed;
+    mbmp_stream_begin(&fed, self_id);
+    for (int i = 0; i < 5 + hex_len; i++) {
+        mbmp_stream_feed(&fed, (uint8_t)line[i]);
+    }
+    for (int i = 0; i < BENCH_ITERATIONS; i++) {
+        MbmpStream_t stream = fed;
+        mbmp_stream_feed(&stream, '\r');
+        sink += mbmp_stream_end(&stream);
+    }
+    double t3 = now_ns();
+
+    printf("%4d hex chars, ID %3d: decode+slot %8.1f ns  stream (whole line) %8.1f ns  after the '\\r' %5.1f ns\n",
+           hex_len, self_id, (t1 - t0) / BENCH_ITERATIONS, (t2 - t1) / BENCH_ITERATIONS,
+           (t3 - t2) / BENCH_ITERATIONS);
+    (void)sink;
+}
+
+static int stream_frame(const uint8_t *frame, int frame_len, int self_id)
+{
+    MbmpStream_t stream;
+
+    mbmp_stream_begin(&stream, self_id);
+    for (int i = 0; i < frame_len; i++) {
+        mbmp_stream_feed(&stream, frame[i]);
+        // The receiver ends the frame on this, it must not fire early
+        if (mbmp_stream_frame_complete(&stream) != (i == frame_len - 1)) {
+            return -100;
+        }
+    }
+    return mbmp_stream_end(&stream);
+}
+
+// Master side of MBMP_FRAME_RUNS: alternating not-polled / polled run lengths from ID 1
+static int runs_from_bitmap(const uint8_t *bitmap, int max_bit, uint8_t *runs, int max_runs)
+{
+    int count = 0;
+    int polled = 0;
+    int run = 0;
+
+    for (int id = 1; id <= max_bit + 1; id++) {
+        int bit = (id <= max_bit) ? (bitmap[(id - 1) / 8] >> ((id - 1) % 8)) & 1 : !polled;
+        if (bit != polled || run == 255) {
+            if (count >= max_runs) {
+                return -1;
+            }
+            runs[count++] = (uint8_t)run;
+            if (run == 255 && bit == polled) {
+                if (count >= max_runs) {
+                    return -1;
+                }
+                runs[count++] = 0; // Empty run of the other kind, the current one carries on
+            } else {
+                polled = bit;
+            }
+            run = 0;
+        }
+        run++;
+    }
+    return count;
+}
+
+// Master side of MBMP_FRAME_IDS: single IDs, and ranges for three or more in a row
+static int ids_from_list(const int *ids, int count, uint8_t *entries, int max_len)
+{
+    int len = 0;
+
+    for (int i = 0; i < count;) {
+        int j = i;
+        while (j + 1 < count && ids[j + 1] == ids[j] + 1) {
+            j++;
+        }
+        int range = (j - i >= 2);
+        if (len + (range ? 4 : 2) > max_len) {
+            return -1;
+        }
+        entries[len++] = (uint8_t)ids[i];
+        entries[len++] = (uint8_t)((ids[i] >> 8) | (range ? MBMP_ID_RANGE >> 8 : 0));
+        if (range) {
+            entries[len++] = (uint8_t)ids[j];
+            entries[len++] = (uint8_t)(ids[j] >> 8);
+            i = j + 1;
+        } else {
+            i++;
+        }
+    }
+    return len;
+}
+
+static void bench_frames(int bitmap_len, int polled_count)
+{
+    static const char digits[] = "0123456789abcdef";
+    uint8_t bitmap[MBMP_MAX_BITMAP_SIZE] = { 0 };
+    char line[5 + 2 * MBMP_MAX_BITMAP_SIZE + 2] = "MBMP:";
+    uint8_t runs[MBMP_FRAME_MAX_PAYLOAD];
+    uint8_t bitmap_frame[MBMP_MAX_BITMAP_SIZE + MBMP_FRAME_OVERHEAD];
+    uint8_t runs_frame[MBMP_FRAME_MAX_PAYLOAD + MBMP_FRAME_OVERHEAD];
+    int max_bit = bitmap_len * 8;
+    volatile int sink = 0;
+
+    for (int i = 0; i < polled_count; i++) {
+        int id = 1 + rand() % max_bit;
+        bitmap[(id - 1) / 8] |= (uint8_t)(1u << ((id - 1) % 8));
+    }
+    for (int i = 0; i < bitmap_len; i++) {
+        line[5 + 2 * i] = digits[bitmap[i] >> 4];
+        line[6 + 2 * i] = digits[bitmap[i] & 0x0F];
+    }
+    strcpy(line + 5 + 2 * bitmap_len, "\r");
+
+    int ids[MBMP_MAX_BITMAP_SIZE * 8];
+    int id_count = 0;
+    uint8_t entries[MBMP_FRAME_MAX_PAYLOAD];
+    uint8_t ids_frame[MBMP_FRAME_MAX_PAYLOAD + MBMP_FRAME_OVERHEAD];
+    for (int id = 1; id <= max_bit; id++) {
+        if ((bitmap[(id - 1) / 8] >> ((id - 1) % 8)) & 1) {
+            ids[id_count++] = id;
+        }
+    }
+    int entries_len = ids_from_list(ids, id_count, entries, sizeof(entries));
+    int ids_frame_len = (entries_len > 0) ? mbmp_frame_encode(MBMP_FRAME_IDS, entries, entries_len, ids_frame, sizeof(ids_frame)) : -1;
+
+    int run_count = runs_from_bitmap(bitmap, max_bit, runs, sizeof(runs));
+    int bitmap_frame_len = mbmp_frame_encode(MBMP_FRAME_BITMAP, bitmap, bitmap_len, bitmap_frame, sizeof(bitmap_frame));
+    int runs_frame_len = (run_count > 0) ? mbmp_frame_encode(MBMP_FRAME_RUNS, runs, run_count, runs_frame, sizeof(runs_frame)) : -1;
+
+    // Every ID must get the same slot from all three forms of the poll
+    for (int id = 1; id <= max_bit; id++) {
+        int slot = stream_line(line, id);
+        if (stream_frame(bitmap_frame, bitmap_frame_len, id) != slot ||
+            (runs_frame_len > 0 && stream_frame(runs_frame, runs_frame_len, id) != slot) ||
+            (ids_frame_len > 0 && (stream_frame(ids_frame, ids_frame_len, id) != slot ||
+                                   mbmp_id_list_get_response_slot(entries, entries_len, id) != slot))) {
+            printf("FRAME MISMATCH for ID %d\n", id);
+            exit(1);
+        }
+    }
+
+    double t0 = now_ns();
+    for (int i = 0; i < BENCH_ITERATIONS; i++) {
+        sink += stream_line(line, max_bit);
+    }
+    double t1 = now_ns();
+    for (int i = 0; i < BENCH_ITERATIONS; i++) {
+        sink += stream_frame(bitmap_frame, bitmap_frame_len, max_bit);
+    }
+    double t2 = now_ns();
+
+    // Wire bytes include the "\r\n" of the hex line; binary frames have none
+    printf("%3d IDs, %3d polled: hex %3d B %7.1f ns  bitmap frame %3d B %7.1f ns  runs frame %3d B  ID list frame %3d B\n",
+           max_bit, polled_count, (int)strlen(line) + 1, (t1 - t0) / BENCH_ITERATIONS,
+           bitmap_frame_len, (t2 - t1) / BENCH_ITERATIONS, runs_frame_len, ids_frame_len);
+    (void)sink;
+}
+
+// Beyond the bitmap: a few devices polled out of a large ID space
+static void bench_id_list(int polled_count, int max_id)
+{
+    int ids[MBMP_FRAME_MAX_PAYLOAD / 2];
+    uint8_t entries[MBMP_FRAME_MAX_PAYLOAD];
+    uint8_t frame[MBMP_FRAME_MAX_PAYLOAD + MBMP_FRAME_OVERHEAD];
+    int count = 0;
+    volatile int sink = 0;
+
+    for (int id = 1; id <= max_id && count < polled_count; id++) {
+        if (rand() % (max_id / polled_count) == 0) {
+            ids[count++] = id;
+            if (count < polled_count && id < max_id && rand() % 4 == 0) {
+                ids[count++] = ++id; // Some neighbours, so ranges appear too
+            }
+        }
+    }
+    int entries_len = ids_from_list(ids, count, entries, sizeof(entries));
+    int frame_len = mbmp_frame_encode(MBMP_FRAME_IDS, entries, entries_len, frame, sizeof(frame));
+
+    // Both against the plain rank in the sorted list
+    for (int id = 1; id <= max_id; id++) {
+        int expected = -1;
+        for (int i = 0; i < count; i++) {
+            if (ids[i] == id) {
+                expected = i;
+            }
+        }
+        if (stream_frame(frame, frame_len, id) != expected ||
+            mbmp_id_list_get_response_slot(entries, entries_len, id) != expected) {
+            printf("ID LIST MISMATCH for ID %d\n", id);
+            exit(1);
+        }
+    }
+
+    double t0 = now_ns();
+    for (int i = 0; i < BENCH_ITERATIONS; i++) {
+        sink += mbmp_id_list_get_response_slot(entries, entries_len, ids[count - 1]);
+    }
+    double t1 = now_ns();
+
+    printf("%5d IDs, %2d polled: ID list frame %3d B (bitmap would be %4d B)  search %6.1f ns\n",
+           max_id, count, frame_len, (max_id + 7) / 8 + MBMP_FRAME_OVERHEAD, (t1 - t0) / BENCH_ITERATIONS);
+    (void)sink;
+}
+
+int main(void)
+{
+    static const uint8_t malformed[] = "a81g";
+    uint8_t bitmap[MBMP_MAX_BITMAP_SIZE];
+
+    srand(1);
+    printf("MBMP hex decode, %d iterations per case\n", BENCH_ITERATIONS);
+    bench(2);
+    bench(16);
+    bench(64);
+    bench(128);
+
+    printf("Response slot, %d iterations per case\n", BENCH_ITERATIONS);
+    bench_slot(3);
+    bench_slot(100);
+    bench_slot(500);
+
+    printf("Streaming parser, %d iterations per case\n", BENCH_ITERATIONS);
+    bench_stream(128, 500);
+    bench_stream(32, 20);
+    printf("stream \"MBMP:0g\" -> %d (expected %d)\n", stream_line("MBMP:0g", 1), MBMP_SLOT_MALFORMED);
+    printf("stream \"NWK=1\" -> %d (expected %d)\n", stream_line("NWK=1", 1), MBMP_SLOT_NOT_MBMP);
+
+    printf("Binary frames, %d iterations per case\n", BENCH_ITERATIONS);
+    bench_frames(64, 200);
+    bench_frames(64, 3);
+    bench_frames(8, 20);
+    bench_id_list(3, 2000);
+    bench_id_list(40, 30000);
+    {
+        uint8_t frame[8];
+        int len = mbmp_frame_encode(MBMP_FRAME_BITMAP, (const uint8_t *)"\x05", 1, frame, sizeof(frame));
+        frame[len - 1] ^= 1;
+        printf("frame with bad CRC -> %d (expected %d)\n", stream_frame(frame, len, 1), MBMP_SLOT_MALFORMED);
+    }
+
+    printf("malformed \"a81g\" -> %d (expected -1)\n",
+           mbmp_decode_hex(malformed, sizeof(malformed) - 1, bitmap, sizeof(bitmap)));
+    return 0;
+}
@@ -0,0 +1,483 @@
+/**
+ * Polling a whole network in virtual time: one master and up to 512 slaves,
+ * each slave with its own copy of the receive side (the streaming parser of
+ * mbmp.c fed byte by byte, as the USART1 ISR does), its slot timing (the poll
+ * end plus slot times ZIGBEE_INTERVAL_RESPONSE_US, counted on its own crystal)
+ * and its reply, all sharing one radio channel. Events on the channel are
+ * replayed in time order to find replies that overlap in the air.
+ *
+ * Between the application and the air sits the Zigbee module. Each direction
+ * gets a random forwarding latency per packet, and packets longer than a radio
+ * frame are split. Those are the numbers to adjust to a real module.
+ *
+ * For every network size, poll encoding and slot width this reports the poll
+ * size and air time, the round duration (from the poll on air to the last reply
+ * off air), the replies lost to collisions, and the jitter of the reply
+ * starts against their ideal slot start. It also reports the narrowest slot
+ * that jitter allows.
+ *
+ * Build and run from this directory:
+ *   make mbmp_network && ./mbmp_network
+ *   ./mbmp_network -n 512 -w 4000,3000 -l 500,1500 -r 1000
+ *
+ * Options: -n node counts, -w slot widths in us, -p percent of the nodes polled
+ * per round, -r rounds, -b link baud rate, -l module latency min,max in us,
+ * -c crystal tolerance in ppm, -y reply bytes (the ID line by default),
+ * -s seed, -v jitter by position of the slot in the round.
+ */
+#include "mbmp.h"
+#include <math.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define NET_MAX_NODES (MBMP_MAX_BITMAP_SIZE * 8)
+#define NET_MAX_POLL (5 + 2 * MBMP_MAX_BITMAP_SIZE + 2)
+#define NET_UART_CHAR_BITS 10      // Start + 8 data + stop bits, as ZIGBEE_UART_CHAR_BITS
+#define NET_AIR_BYTE_US 32.0       // 250 kbit/s O-QPSK at 2.4 GHz
+#define NET_AIR_OVERHEAD 31        // PHY, MAC, NWK and APS headers of a data frame
+#define NET_AIR_MAX_PAYLOAD 80     // Longer packets go out as several frames
+#define NET_AIR_FRAME_GAP_US 192.0 // Turnaround between the frames of one packet
+#define NET_ISR_MAX_US 5.0         // Poll end seen late by the RX event, as measured by zigbee_host
+#define NET_JITTER_BANDS 8         // -v splits the slots of a round into this many bands
+
+typedef enum {
+    NET_ENC_HEX,    // "MBMP:<hex>\r\n"
+    NET_ENC_BITMAP, // MBMP_FRAME_BITMAP
+    NET_ENC_RUNS,   // MBMP_FRAME_RUNS
+    NET_ENC_IDS,    // MBMP_FRAME_IDS
+    NET_ENC_COUNT
+} NetEncoding_t;
+
+static const char *const net_encoding_names[NET_ENC_COUNT] = { "hex", "bitmap", "runs", "ids" };
+
+typedef struct {
+    int id;
+    double clock_error;   // Relative, from the crystal tolerance
+    MbmpStream_t stream;  // The slave's own parser state
+} NetNode_t;
+
+typedef struct {
+    double start_us;      // Reply on air
+    double end_us;
+} NetAirReply_t;
+
+typedef struct {
+    double min;
+    double max;
+    double sum;
+    double sq;
+    long count;
+} NetJitter_t;
+
+typedef struct {
+    uint32_t baud;
+    double latency_min_us;
+    double latency_max_us;
+    double ppm;
+    int reply_bytes;      // 0: the ID line, digits and '\n'
+    int polled_percent;
+    int rounds;
+    bool verbose;         // Jitter by slot band as well
+} NetConfig_t;
+
+typedef struct {
+    int rounds;           // Polled, those the encoding could carry
+    int unfit;            // Rounds whose poll the encoding could not carry
+    double poll_bytes;
+    double poll_air_us;
+    double round_us;
+    double replies;
+    double collided;
+    double wrong_slot;    // Slave disagreeing with the master on its slot
+    double reply_air_max_us;
+    NetJitter_t jitter;                          // Reply on air against the ideal slot start
+    NetJitter_t jitter_bands[NET_JITTER_BANDS];  // The same by position of the slot in the round
+} NetResult_t;
+
+static NetNode_t nodes[NET_MAX_NODES];
+
+/* ------------------------------- Helpers ---------------------------------- */
+
+static double net_uniform(double min, double max)
+{
+    return min + (max - min) * ((double)rand() / RAND_MAX);
+}
+
+static double net_air_us(int len)
+{
+    int frames = (len + NET_AIR_MAX_PAYLOAD - 1) / NET_AIR_MAX_PAYLOAD;
+
+    return (len + frames * NET_AIR_OVERHEAD) * NET_AIR_BYTE_US + (frames - 1) * NET_AIR_FRAME_GAP_US;
+}
+
+static void net_jitter_add(NetJitter_t *jitter, double value)
+{
+    if (jitter->count == 0 || value < jitter->min) {
+        jitter->min = value;
+    }
+    if (jitter->count == 0 || value > jitter->max) {
+        jitter->max = value;
+    }
+    jitter->sum += value;
+    jitter->sq += value * value;
+    jitter->count++;
+}
+
+static double net_jitter_sd(const NetJitter_t *jitter)
+{
+    double mean = jitter->sum / jitter->count;
+    return sqrt(fmax(0, jitter->sq / jitter->count - mean * mean));
+}
+
+static int net_reply_len(const NetConfig_t *config, int id)
+{
+    if (config->reply_bytes > 0) {
+        return config->reply_bytes;
+    }
+    return (id >= 100) ? 4 : (id >= 10) ? 3 : 2;
+}
+
+static int compare_reply(const void *a, const void *b)
+{
+    double x = ((const NetAirReply_t *)a)->start_us;
+    double y = ((const NetAirReply_t *)b)->start_us;
+    return (x > y) - (x < y);
+}
+
+/* ----------------------------- Master side -------------------------------- */
+
+// MBMP_FRAME_RUNS: alternating not-polled / polled run lengths from ID 1, as in mbmp_bench
+static int net_runs(const uint8_t *bitmap, int max_bit, uint8_t *runs, int max_runs)
+{
+    int count = 0;
+    int polled = 0;
+    int run = 0;
+
+    for (int id = 1; id <= max_bit + 1; id++) {
+        int bit = (id <= max_bit) ? (bitmap[(id - 1) / 8] >> ((id - 1) % 8)) & 1 : !polled;
+        if (bit != polled || run == 255) {
+            if (count >= max_runs) {
+                return -1;
+            }
+            runs[count++] = (uint8_t)run;
+            if (run == 255 && bit == polled) {
+                if (count >= max_runs) {
+                    return -1;
+                }
+                runs[count++] = 0; // Empty run of the other kind, the current one carries on
+            } else {
+                polled = bit;
+            }
+            run = 0;
+        }
+        run++;
+    }
+    return count;
+}
+
+// MBMP_FRAME_IDS: single IDs, and ranges for three or more in a row
+static int net_ids(const int *ids, int count, uint8_t *entries, int max_len)
+{
+    int len = 0;
+
+    for (int i = 0; i < count;) {
+        int j = i;
+        while (j + 1 < count && ids[j + 1] == ids[j] + 1) {
+            j++;
+        }
+        int range = (j - i >= 2);
+        if (len + (range ? 4 : 2) > max_len) {
+            return -1;
+        }
+        entries[len++] = (uint8_t)ids[i];
+        entries[len++] = (uint8_t)((ids[i] >> 8) | (range ? MBMP_ID_RANGE >> 8 : 0));
+        if (range) {
+            entries[len++] = (uint8_t)ids[j];
+            entries[len++] = (uint8_t)(ids[j] >> 8);
+            i = j + 1;
+        } else {
+            i++;
+        }
+    }
+    return len;
+}
+
+/**
+ * @brief Encodes one poll the way the master would send it.
+ * @return The poll length, or -1 if it does not fit the encoding.
+ */
+static int net_poll_build(NetEncoding_t encoding, const uint8_t *bitmap, int bitmap_len, const int *ids,
+                          int count, uint8_t *poll)
+{
+    static const char digits[] = "0123456789abcdef";
+    uint8_t payload[MBMP_FRAME_MAX_PAYLOAD];
+    int len;
+
+    switch (encoding) {
+    case NET_ENC_HEX:
+        memcpy(poll, "MBMP:", 5);
+        len = 5;
+        for (int i = 0; i < bitmap_len; i++) {
+            poll[len++] = (uint8_t)digits[bitmap[i] >> 4];
+            poll[len++] = (uint8_t)digits[bitmap[i] & 0x0F];
+        }
+        poll[len++] = '\r';
+        poll[len++] = '\n';
+        return len;
+    case NET_ENC_BITMAP:
+        return mbmp_frame_encode(MBMP_FRAME_BITMAP, bitmap, bitmap_len, poll, NET_MAX_POLL);
+    case NET_ENC_RUNS:
+        len = net_runs(bitmap, bitmap_len * 8, payload, sizeof(payload));
+        return (len > 0) ? mbmp_frame_encode(MBMP_FRAME_RUNS, payload, len, poll, NET_MAX_POLL) : -1;
+    case NET_ENC_IDS:
+        len = net_ids(ids, count, payload, sizeof(payload));
+        return (len > 0) ? mbmp_frame_encode(MBMP_FRAME_IDS, payload, len, poll, NET_MAX_POLL) : -1;
+    default:
+        return -1;
+    }
+}
+
+/* ------------------------------- One round -------------------------------- */
+
+/**
+ * @brief Polls the network once and adds what happened on the channel to result.
+ */
+static void net_round(const NetConfig_t *config, int node_count, NetEncoding_t encoding, double slot_us,
+                      NetResult_t *result)
+{
+    static NetAirReply_t air[NET_MAX_NODES];
+    uint8_t bitmap[MBMP_MAX_BITMAP_SIZE] = { 0 };
+    uint8_t poll[NET_MAX_POLL];
+    int ids[NET_MAX_NODES];
+    int count = 0;
+    int bitmap_len = (node_count + 7) / 8;
+    double char_us = NET_UART_CHAR_BITS * 1e6 / config->baud;
+    double latency_mean = (config->latency_min_us + config->latency_max_us) / 2;
+
+    for (int i = 0; i < node_count; i++) {
+        if (rand() % 100 < config->polled_percent) {
+            ids[count++] = nodes[i].id;
+            bitmap[(nodes[i].id - 1) / 8] |= (uint8_t)(1u << ((nodes[i].id - 1) % 8));
+        }
+    }
+    int len = net_poll_build(encoding, bitmap, bitmap_len, ids, count, poll);
+    if (count == 0) {
+        return;
+    }
+    if (len < 0) {
+        result->unfit++;
+        return;
+    }
+    double poll_air_end = net_air_us(len);
+    result->rounds++;
+    result->poll_bytes += len;
+    result->poll_air_us += poll_air_end;
+
+    // Every slave hears the poll through its own module, then counts its slot on its own clock
+    int replies = 0;
+    int expected_slot = 0;
+    for (int i = 0; i < node_count; i++) {
+        NetNode_t *node = &nodes[i];
+        double uart_start = poll_air_end + net_uniform(config->latency_min_us, config->latency_max_us);
+
+        // As zigbee_rx_push_byte(): the '\n' of a text line ends it without being parsed
+        mbmp_stream_begin(&node->stream, node->id);
+        for (int k = 0; k < len - (encoding == NET_ENC_HEX); k++) {
+            mbmp_stream_feed(&node->stream, poll[k]);
+        }
+        int slot = mbmp_stream_end(&node->stream);
+        bool polled = (bitmap[(node->id - 1) / 8] >> ((node->id - 1) % 8)) & 1;
+        if (!polled) {
+            result->wrong_slot += (slot != MBMP_SLOT_NOT_POLLED);
+            continue;
+        }
+        if (slot != expected_slot++) {
+            result->wrong_slot++;
+            continue;
+        }
+
+        int reply_len = net_reply_len(config, node->id);
+        double end_us = uart_start + len * char_us + net_uniform(0, NET_ISR_MAX_US);
+        double tx_us = end_us + slot * slot_us * (1.0 + node->clock_error);
+        double air_start = tx_us + reply_len * char_us + net_uniform(config->latency_min_us, config->latency_max_us);
+        double reply_air = net_air_us(reply_len);
+
+        // Ideal: the same path with every latency at its mean and a perfect crystal
+        double ideal = poll_air_end + latency_mean + len * char_us + NET_ISR_MAX_US / 2 + slot * slot_us +
+                       reply_len * char_us + latency_mean;
+        net_jitter_add(&result->jitter, air_start - ideal);
+        net_jitter_add(&result->jitter_bands[slot * NET_JITTER_BANDS / count], air_start - ideal);
+        result->reply_air_max_us = fmax(result->reply_air_max_us, reply_air);
+
+        air[replies].start_us = air_start;
+        air[replies].end_us = air_start + reply_air;
+        replies++;
+    }
+
+    // Replay the channel in time order: a reply that starts before an earlier one ended
+    // collides, and so does the one it ran into
+    qsort(air, replies, sizeof(air[0]), compare_reply);
+    double busy_until = 0;
+    int collided = 0;
+    bool busy_counted = false;
+    for (int r = 0; r < replies; r++) {
+        if (air[r].start_us < busy_until) {
+            collided += busy_counted ? 1 : 2;
+            busy_counted = true;
+        } else {
+            busy_counted = false;
+        }
+        busy_until = fmax(busy_until, air[r].end_us);
+    }
+
+    result->round_us += (replies > 0) ? busy_until : poll_air_end;
+    result->replies += replies;
+    result->collided += collided;
+}
+
+/* --------------------------------- Report --------------------------------- */
+
+static void net_run(const NetConfig_t *config, int node_count, NetEncoding_t encoding, double slot_us)
+{
+    NetResult_t result = { 0 };
+
+    for (int i = 0; i < node_count; i++) {
+        nodes[i].id = i + 1;
+        nodes[i].clock_error = net_uniform(-config->ppm, config->ppm) * 1e-6;
+    }
+    for (int r = 0; r < config->rounds; r++) {
+        net_round(config, node_count, encoding, slot_us, &result);
+    }
+    int rounds = result.rounds;
+    if (rounds == 0) {
+        printf("%5d  %-6s  %5s  (poll does not fit a frame)\n", node_count, net_encoding_names[encoding], "-");
+        return;
+    }
+
+    // Narrowest slot with no overlap even for the worst pair seen: a reply air time plus
+    // the whole jitter range
+    double slot_min = result.reply_air_max_us + (result.jitter.max - result.jitter.min);
+    printf("%5d  %-6s  %5.0f  %6.2f  %6.1f  %8.1f  %7.1f  %6.2f%%  %+7.0f %+7.0f %6.0f  %7.2f", node_count,
+           net_encoding_names[encoding], result.poll_bytes / rounds, result.poll_air_us / rounds / 1000,
+           slot_us / 1000, result.round_us / rounds / 1000, result.replies / rounds,
+           (result.replies > 0) ? 100.0 * result.collided / result.replies : 0.0, result.jitter.min,
+           result.jitter.max, net_jitter_sd(&result.jitter), slot_min / 1000);
+    if (result.unfit != 0) {
+        printf("  %d polls too long", result.unfit);
+    }
+    printf("%s\n", (result.wrong_slot != 0) ? "  SLOT MISMATCH" : "");
+
+    // Crystal drift grows with the slot number, latency jitter does not
+    for (int b = 0; config->verbose && b < NET_JITTER_BANDS; b++) {
+        const NetJitter_t *band = &result.jitter_bands[b];
+        if (band->count != 0) {
+            printf("         slots %3d-%3d%% of the round: jitter %+7.0f %+7.0f %6.0f us\n", 100 * b / NET_JITTER_BANDS,
+                   100 * (b + 1) / NET_JITTER_BANDS, band->min, band->max, net_jitter_sd(band));
+        }
+    }
+}
+
+/**
+ * @brief Parses a comma separated list of numbers.
+ * @return How many were read.
+ */
+static int net_parse_list(const char *text, double *values, int max_values)
+{
+    int count = 0;
+    char *end;
+
+    while (count < max_values && *text != '\0') {
+        values[count++] = strtod(text, &end);
+        if (*end != ',') {
+            break;
+        }
+        text = end + 1;
+    }
+    return count;
+}
+
+int main(int argc, char **argv)
+{
+    NetConfig_t config = {
+        .baud = 460800, .latency_min_us = 1000, .latency_max_us = 3000, .ppm = 20,
+        .reply_bytes = 0, .polled_percent = 100, .rounds = 200,
+    };
+    double node_counts[8] = { 50, 200, 512 };
+    double slot_widths[8] = { 10000, 5000 }; // ZIGBEE_INTERVAL_RESPONSE_US of the application, and half
+    int node_count_n = 3;
+    int slot_width_n = 2;
+    double latency[2];
+    unsigned seed = 1;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "n:w:p:r:b:l:c:y:s:v")) != -1) {
+        switch (opt) {
+        case 'n':
+            node_count_n = net_parse_list(optarg, node_counts, 8);
+            break;
+        case 'w':
+            slot_width_n = net_parse_list(optarg, slot_widths, 8);
+            break;
+        case 'p':
+            config.polled_percent = atoi(optarg);
+            break;
+        case 'r':
+            config.rounds = atoi(optarg);
+            break;
+        case 'b':
+            config.baud = (uint32_t)strtoul(optarg, NULL, 10);
+            break;
+        case 'l':
+            if (net_parse_list(optarg, latency, 2) != 2 || latency[0] > latency[1]) {
+                fprintf(stderr, "-l takes min,max\n");
+                return 1;
+            }
+            config.latency_min_us = latency[0];
+            config.latency_max_us = latency[1];
+            break;
+        case 'c':
+            config.ppm = strtod(optarg, NULL);
+            break;
+        case 'y':
+            config.reply_bytes = atoi(optarg);
+            break;
+        case 's':
+            seed = (unsigned)strtoul(optarg, NULL, 10);
+            break;
+        case 'v':
+            config.verbose = true;
+            break;
+        default:
+            fprintf(stderr, "usage: %s [-n 50,200,512] [-w 10000,5000] [-p percent] [-r rounds] [-b baud]\n"
+                            "       [-l min_us,max_us] [-c ppm] [-y reply_bytes] [-s seed] [-v]\n", argv[0]);
+            return 1;
+        }
+    }
+    for (int n = 0; n < node_count_n; n++) {
+        if (node_counts[n] < 1 || node_counts[n] > NET_MAX_NODES) {
+            fprintf(stderr, "node counts must be 1 to %d\n", NET_MAX_NODES);
+            return 1;
+        }
+    }
+    if (config.rounds <= 0 || config.baud == 0 || config.polled_percent <= 0) {
+        return 1;
+    }
+
+    printf("%u baud, module latency %.0f-%.0f us each way, crystal +-%.0f ppm, %d%% polled, %d rounds\n",
+           config.baud, config.latency_min_us, config.latency_max_us, config.ppm, config.polled_percent,
+           config.rounds);
+    printf("nodes  poll   bytes  air ms  slot ms  round ms  replies  collided  jitter us: min   max     sd  "
+           "min slot ms\n");
+    for (int n = 0; n < node_count_n; n++) {
+        for (int w = 0; w < slot_width_n; w++) {
+            for (int e = 0; e < NET_ENC_COUNT; e++) {
+                srand(seed); // Every encoding sees the same polls and delays
+                net_run(&config, (int)node_counts[n], (NetEncoding_t)e, slot_widths[w]);
+            }
+        }
+    }
+    return 0;
+}
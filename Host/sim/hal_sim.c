@@ -0,0 +1,805 @@
+/**
+ * Simulated HAL for the host build: the peripherals behind stm32f1xx_hal.h,
+ * driven by a virtual microsecond clock. See hal_sim.h for the model.
+ */
+#define _GNU_SOURCE
+#include "hal_sim.h"
+#include "console.h"
+#include "latency.h"
+#include "low_power.h"
+#include "profiler.h"
+#include "scheduler.h"
+#include "tim.h"
+#include "uart_tx.h"
+#include "usart.h"
+#include "zigbee_timer.h"
+#include "zigbee_uart_handle.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+
+#ifndef MAP_FIXED_NOREPLACE
+#define MAP_FIXED_NOREPLACE 0x100000 // Older headers; a kernel without it takes the address as a hint
+#endif
+
+#define SIM_NEVER UINT64_MAX
+#define SIM_UART_CHAR_BITS 10        // Start + 8 data + stop bits, as configured in usart.c
+#define SIM_TICK_US 1000u            // SysTick period
+#define SIM_TIM_PERIOD_US 65536u     // TIM2 counts microseconds up to 0xFFFF
+#define SIM_RX_FIFO_SIZE 4096u       // Bytes on their way to USART1, must be a power of two
+#define SIM_RX_FIFO_MASK (SIM_RX_FIFO_SIZE - 1)
+#define SIM_EVENT_MAX 1024           // Pending sim_schedule() callbacks
+#define SIM_FLASH_SIZE (FLASH_BANK1_END + 1 - FLASH_BASE)
+
+// Interrupt sources, serviced in this order when they fall due at the same time
+typedef enum {
+    SIM_SRC_NONE = 0,
+    SIM_SRC_TICK,
+    SIM_SRC_TIM_UPDATE,
+    SIM_SRC_TIM_CC1,
+    SIM_SRC_RX,
+    SIM_SRC_TX1,
+    SIM_SRC_TX2,
+    SIM_SRC_EVENT
+} SimSource_t;
+
+typedef struct {
+    uint64_t at_us;
+    uint64_t seq;  // Keeps callbacks due at the same time in scheduling order
+    SimEventFn_t fn;
+    void *arg;
+} SimEvent_t;
+
+typedef struct {
+    uint8_t data;
+    uint64_t at_us; // When its stop bit has been received
+} SimRxByte_t;
+
+/* ------------------------------ Peripheral handles ----------------------------- */
+
+UART_HandleTypeDef huart1 = { USART1, { 115200, UART_WORDLENGTH_8B, UART_STOPBITS_1, UART_PARITY_NONE,
+                                        UART_MODE_TX_RX, UART_HWCONTROL_NONE, UART_OVERSAMPLING_16 }, 0 };
+UART_HandleTypeDef huart2 = { USART2, { 115200, UART_WORDLENGTH_8B, UART_STOPBITS_1, UART_PARITY_NONE,
+                                        UART_MODE_TX_RX, UART_HWCONTROL_NONE, UART_OVERSAMPLING_16 }, 0 };
+DMA_HandleTypeDef hdma_usart1_rx = { 5 };
+DMA_HandleTypeDef hdma_usart1_tx = { 4 };
+DMA_HandleTypeDef hdma_usart2_tx = { 7 };
+TIM_HandleTypeDef htim2 = { TIM2, HAL_TIM_ACTIVE_CHANNEL_CLEARED };
+
+USART_TypeDef sim_usart1 = { 1 };
+USART_TypeDef sim_usart2 = { 2 };
+TIM_TypeDef sim_tim2 = { 2 };
+GPIO_TypeDef sim_gpioa = { 0 };
+GPIO_TypeDef sim_gpiob = { 1 };
+GPIO_TypeDef sim_gpioc = { 2 };
+CoreDebug_Type sim_core_debug;
+DWT_Type sim_dwt;
+
+uint32_t SystemCoreClock = 64000000u;
+volatile uint32_t uwTick = 0;
+volatile uint32_t sim_primask = 0;
+
+/* ---------------------------------- Sim state ---------------------------------- */
+
+static uint64_t sim_now = 0;
+static uint64_t sim_run_end = 0;
+static bool sim_in_isr = false;
+static SimStats_t sim_counters;
+static SimTxHook_t sim_tx_hook = NULL;
+static SimGpioHook_t sim_gpio_hook = NULL;
+static uint32_t sim_uid[3] = { 0x0032FF05u, 0x3238510Bu, 0x43117139u };
+
+static bool tick_enabled = true;
+static uint64_t tick_next_us = SIM_TICK_US;
+
+static bool tim_running = false;
+static uint32_t tim_stopped_count = 0;
+static uint64_t tim_base_us = 0;      // When the counter was last at 0
+static uint64_t tim_update_us = SIM_NEVER;
+static uint64_t tim_cc1_us = SIM_NEVER;
+static uint32_t tim_ccr1 = 0;
+static uint32_t tim_it = 0;
+static uint32_t tim_flags = 0;
+
+static SimRxByte_t rx_fifo[SIM_RX_FIFO_SIZE];
+static uint32_t rx_fifo_head = 0;
+static uint32_t rx_fifo_tail = 0;
+static uint64_t rx_wire_free_us = 0;  // End of the last injected byte
+static uint8_t *rx_dma_buf = NULL;
+static uint16_t rx_dma_size = 0;
+static uint16_t rx_dma_pos = 0;
+static bool rx_dma_on = false;
+static uint32_t rx_since_idle = 0;    // Bytes received since the last idle line event
+static uint64_t rx_last_us = 0;
+static uint64_t rx_event_us = SIM_NEVER; // Next receive event, planned by sim_rx_plan()
+static uint32_t rx_event_count = 0;
+static HAL_UART_RxEventTypeTypeDef rx_event_type = HAL_UART_RXEVENT_IDLE;
+
+static struct {
+    bool busy;
+    uint64_t done_us;
+} sim_tx[2];
+
+static uint8_t *rx2_buf = NULL;       // HAL_UART_Receive_IT() buffer on USART2, NULL when idle
+static uint16_t rx2_size = 0;
+static uint16_t rx2_pos = 0;
+static uint64_t rx2_wire_free_us = 0; // End of the last byte injected on USART2
+
+static SimEvent_t sim_events[SIM_EVENT_MAX]; // Binary heap on (at_us, seq)
+static uint32_t sim_event_count = 0;
+static uint64_t sim_event_seq = 0;
+
+static bool sim_flash_locked = true;
+static bool sim_flash_mapped = false;
+
+/* ----------------------------------- Helpers ----------------------------------- */
+
+static void sim_set_now(uint64_t now_us)
+{
+    if (sim_dwt.CTRL & DWT_CTRL_CYCCNTENA_Msk) {
+        sim_dwt.CYCCNT += (uint32_t)((now_us - sim_now) * (SystemCoreClock / 1000000u));
+    }
+    sim_now = now_us;
+}
+
+/**
+ * @brief Returns the time one character takes on the UART at its configured rate.
+ */
+uint32_t sim_uart_char_us(const UART_HandleTypeDef *huart)
+{
+    return (SIM_UART_CHAR_BITS * 1000000u + huart->Init.BaudRate - 1) / huart->Init.BaudRate;
+}
+
+static bool sim_event_before(const SimEvent_t *a, const SimEvent_t *b)
+{
+    return a->at_us < b->at_us || (a->at_us == b->at_us && a->seq < b->seq);
+}
+
+static void sim_event_pop(void)
+{
+    uint32_t i = 0;
+
+    sim_events[0] = sim_events[--sim_event_count];
+    for (;;) {
+        uint32_t child = 2 * i + 1;
+        if (child >= sim_event_count) {
+            break;
+        }
+        if (child + 1 < sim_event_count && sim_event_before(&sim_events[child + 1], &sim_events[child])) {
+            child++;
+        }
+        if (!sim_event_before(&sim_events[child], &sim_events[i])) {
+            break;
+        }
+        SimEvent_t swap = sim_events[i];
+        sim_events[i] = sim_events[child];
+        sim_events[child] = swap;
+        i = child;
+    }
+}
+
+/**
+ * @brief Works out when USART1 raises its next receive event and how many bytes it hands over:
+ *        half and full DMA buffer like the circular DMA, or one character of silence after
+ *        the last byte like the idle line detection.
+ */
+static void sim_rx_plan(void)
+{
+    uint32_t char_us = sim_uart_char_us(&huart1);
+    uint16_t pos = rx_dma_pos;
+
+    rx_event_us = SIM_NEVER;
+    rx_event_count = 0;
+    if (rx_fifo_tail == rx_fifo_head) {
+        if (rx_dma_on && rx_since_idle != 0) {
+            rx_event_us = rx_last_us + char_us;
+            rx_event_type = HAL_UART_RXEVENT_IDLE;
+        }
+        return;
+    }
+    if (!rx_dma_on) {
+        rx_event_us = rx_fifo[rx_fifo_tail & SIM_RX_FIFO_MASK].at_us; // Lost as it arrives
+        rx_event_count = 1;
+        return;
+    }
+    if (rx_since_idle != 0 && rx_fifo[rx_fifo_tail & SIM_RX_FIFO_MASK].at_us > rx_last_us + char_us + 1) {
+        rx_event_us = rx_last_us + char_us;
+        rx_event_type = HAL_UART_RXEVENT_IDLE;
+        return;
+    }
+    for (uint32_t i = rx_fifo_tail; i != rx_fifo_head; i++) {
+        uint64_t at_us = rx_fifo[i & SIM_RX_FIFO_MASK].at_us;
+        rx_event_count++;
+        pos++;
+        if (pos == rx_dma_size / 2 || pos == rx_dma_size) {
+            rx_event_us = at_us;
+            rx_event_type = (pos == rx_dma_size) ? HAL_UART_RXEVENT_TC : HAL_UART_RXEVENT_HT;
+            return;
+        }
+        // The one-bit rounding of the arrival times is not a gap
+        if (i + 1 == rx_fifo_head || rx_fifo[(i + 1) & SIM_RX_FIFO_MASK].at_us > at_us + char_us + 1) {
+            rx_event_us = at_us + char_us;
+            rx_event_type = HAL_UART_RXEVENT_IDLE;
+            return;
+        }
+    }
+}
+
+static void sim_rx_service(void)
+{
+    uint32_t count = rx_event_count;
+
+    if (!rx_dma_on) {
+        rx_fifo_tail += count;
+        sim_counters.rx_lost += count;
+        sim_rx_plan();
+        return;
+    }
+
+    while (count--) {
+        SimRxByte_t *byte = &rx_fifo[rx_fifo_tail++ & SIM_RX_FIFO_MASK];
+        rx_dma_buf[rx_dma_pos++] = byte->data;
+        rx_last_us = byte->at_us;
+        rx_since_idle++;
+        sim_counters.rx_bytes++;
+    }
+    if (rx_event_type == HAL_UART_RXEVENT_IDLE) {
+        rx_since_idle = 0;
+    }
+
+    // Size is the DMA write position, the full buffer size at transfer complete
+    uint16_t size = rx_dma_pos;
+    if (rx_dma_pos == rx_dma_size) {
+        rx_dma_pos = 0;
+    }
+    huart1.RxEventType = rx_event_type;
+    sim_counters.rx_events++;
+    HAL_UARTEx_RxEventCallback(&huart1, size);
+    sim_rx_plan();
+}
+
+static void sim_tim_plan_cc1(void)
+{
+    uint32_t delta = (tim_ccr1 - sim_tim_get_counter()) & 0xFFFFu;
+    tim_cc1_us = sim_now + (delta != 0 ? delta : SIM_TIM_PERIOD_US);
+}
+
+static SimSource_t sim_next_source(uint64_t *at_us)
+{
+    SimSource_t source = SIM_SRC_NONE;
+    uint64_t best = SIM_NEVER;
+
+#define SIM_CONSIDER(cond, time, src) \
+    if ((cond) && (time) < best) { best = (time); source = (src); }
+
+    SIM_CONSIDER(tick_enabled, tick_next_us, SIM_SRC_TICK);
+    SIM_CONSIDER(tim_running && (tim_it & TIM_IT_UPDATE), tim_update_us, SIM_SRC_TIM_UPDATE);
+    SIM_CONSIDER(tim_running && (tim_it & TIM_IT_CC1), tim_cc1_us, SIM_SRC_TIM_CC1);
+    SIM_CONSIDER(true, rx_event_us, SIM_SRC_RX);
+    SIM_CONSIDER(sim_tx[0].busy, sim_tx[0].done_us, SIM_SRC_TX1);
+    SIM_CONSIDER(sim_tx[1].busy, sim_tx[1].done_us, SIM_SRC_TX2);
+    SIM_CONSIDER(sim_event_count != 0, sim_events[0].at_us, SIM_SRC_EVENT);
+#undef SIM_CONSIDER
+
+    *at_us = best;
+    return source;
+}
+
+/**
+ * @brief Runs the handlers of every interrupt due by now, like the NVIC once they are unmasked.
+ */
+static void sim_service(void)
+{
+    SimSource_t source;
+    uint64_t at_us;
+
+    sim_in_isr = true;
+    while ((source = sim_next_source(&at_us)) != SIM_SRC_NONE && at_us <= sim_now) {
+        sim_counters.interrupts++;
+        switch (source) {
+        case SIM_SRC_TICK:
+            tick_next_us += SIM_TICK_US;
+            sim_counters.ticks++;
+            uwTick++;
+            scheduler_tick();
+            break;
+        case SIM_SRC_TIM_UPDATE:
+            tim_update_us += SIM_TIM_PERIOD_US;
+            tim_flags &= ~TIM_FLAG_UPDATE;
+            HAL_TIM_PeriodElapsedCallback(&htim2);
+            break;
+        case SIM_SRC_TIM_CC1:
+            tim_cc1_us += SIM_TIM_PERIOD_US;
+            htim2.Channel = HAL_TIM_ACTIVE_CHANNEL_1;
+            HAL_TIM_OC_DelayElapsedCallback(&htim2);
+            htim2.Channel = HAL_TIM_ACTIVE_CHANNEL_CLEARED;
+            break;
+        case SIM_SRC_RX:
+            sim_rx_service();
+            break;
+        case SIM_SRC_TX1:
+        case SIM_SRC_TX2:
+            sim_tx[source - SIM_SRC_TX1].busy = false;
+            HAL_UART_TxCpltCallback((source == SIM_SRC_TX1) ? &huart1 : &huart2);
+            break;
+        case SIM_SRC_EVENT: {
+            SimEvent_t event = sim_events[0];
+            sim_event_pop();
+            event.fn(event.arg);
+            break;
+        }
+        default:
+            break;
+        }
+    }
+    sim_in_isr = false;
+}
+
+/* --------------------------------- Control API --------------------------------- */
+
+/**
+ * @brief Maps the flash at its real address, erased, and starts the clock from zero.
+ *        Call once, before anything else.
+ */
+void sim_init(void)
+{
+    if (!sim_flash_mapped) {
+        void *flash = mmap((void *)FLASH_BASE, SIM_FLASH_SIZE, PROT_READ | PROT_WRITE,
+                           MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED_NOREPLACE, -1, 0);
+        if (flash != (void *)FLASH_BASE) {
+            fprintf(stderr, "sim: cannot map the flash at 0x%08lx\n", (unsigned long)FLASH_BASE);
+            exit(1);
+        }
+        sim_flash_mapped = true;
+    }
+    memset((void *)FLASH_BASE, 0xFF, SIM_FLASH_SIZE);
+
+    sim_now = 0;
+    tick_enabled = true;
+    tick_next_us = SIM_TICK_US;
+    uwTick = 0;
+    memset(&sim_counters, 0, sizeof(sim_counters));
+}
+
+/**
+ * @brief Starts the application the way main() does after the CubeMX initialisation.
+ */
+void sim_boot(void)
+{
+    uart_tx_init();
+    console_init();
+    profiler_init();
+    latency_init();
+    zigbee_timer_start();
+    low_power_init();
+    zigbee_init();
+}
+
+/**
+ * @brief Runs the main loop until the virtual clock reaches end_us.
+ */
+void sim_run_until(uint64_t end_us)
+{
+    sim_run_end = end_us;
+    while (sim_now < end_us) {
+        scheduler_dispatch();
+    }
+}
+
+void sim_run_for(uint64_t duration_us)
+{
+    sim_run_until(sim_now + duration_us);
+}
+
+uint64_t sim_now_us(void)
+{
+    return sim_now;
+}
+
+/**
+ * @brief Runs fn(arg) at at_us, in interrupt context. Callbacks model the outside world:
+ *        they inject bytes, schedule more callbacks, record what they see.
+ * @return false if too many callbacks are pending.
+ */
+bool sim_schedule(uint64_t at_us, SimEventFn_t fn, void *arg)
+{
+    if (sim_event_count == SIM_EVENT_MAX) {
+        return false;
+    }
+
+    uint32_t i = sim_event_count++;
+    sim_events[i] = (SimEvent_t){ (at_us > sim_now) ? at_us : sim_now, sim_event_seq++, fn, arg };
+    while (i > 0 && sim_event_before(&sim_events[i], &sim_events[(i - 1) / 2])) {
+        SimEvent_t swap = sim_events[i];
+        sim_events[i] = sim_events[(i - 1) / 2];
+        sim_events[(i - 1) / 2] = swap;
+        i = (i - 1) / 2;
+    }
+    return true;
+}
+
+/**
+ * @brief Puts bytes on the USART1 RX line, back to back at the current rate, from now or
+ *        from the end of the bytes injected before if those are still arriving.
+ * @return When the last byte has been received.
+ */
+uint64_t sim_uart_inject(const uint8_t *data, uint16_t len)
+{
+    uint64_t start_us = (rx_wire_free_us > sim_now) ? rx_wire_free_us : sim_now;
+    uint32_t baud = huart1.Init.BaudRate;
+
+    for (uint16_t i = 0; i < len; i++) {
+        if (rx_fifo_head - rx_fifo_tail == SIM_RX_FIFO_SIZE) {
+            sim_counters.rx_lost += len - i;
+            break;
+        }
+        uint64_t at_us = start_us + (uint64_t)(i + 1) * SIM_UART_CHAR_BITS * 1000000u / baud;
+        rx_fifo[rx_fifo_head++ & SIM_RX_FIFO_MASK] = (SimRxByte_t){ data[i], at_us };
+        rx_wire_free_us = at_us;
+    }
+    sim_rx_plan();
+    return rx_wire_free_us;
+}
+
+/**
+ * @brief Receives one USART2 byte, with the interrupt reception running or into the void.
+ */
+static void sim_console_byte(void *arg)
+{
+    if (rx2_buf == NULL) {
+        sim_counters.rx_lost++;
+        return;
+    }
+    rx2_buf[rx2_pos++] = (uint8_t)(uintptr_t)arg;
+    if (rx2_pos == rx2_size) {
+        rx2_buf = NULL;
+        HAL_UART_RxCpltCallback(&huart2);
+    }
+}
+
+/**
+ * @brief Puts bytes on the USART2 RX line, the console, like sim_uart_inject() does on USART1.
+ * @return When the last byte has been received, 0 if too many callbacks are pending.
+ */
+uint64_t sim_console_inject(const uint8_t *data, uint16_t len)
+{
+    uint64_t start_us = (rx2_wire_free_us > sim_now) ? rx2_wire_free_us : sim_now;
+    uint32_t baud = huart2.Init.BaudRate;
+
+    for (uint16_t i = 0; i < len; i++) {
+        uint64_t at_us = start_us + (uint64_t)(i + 1) * SIM_UART_CHAR_BITS * 1000000u / baud;
+        if (!sim_schedule(at_us, sim_console_byte, (void *)(uintptr_t)data[i])) {
+            return 0;
+        }
+        rx2_wire_free_us = at_us;
+    }
+    return rx2_wire_free_us;
+}
+
+void sim_set_tx_hook(SimTxHook_t hook)
+{
+    sim_tx_hook = hook;
+}
+
+void sim_set_gpio_hook(SimGpioHook_t hook)
+{
+    sim_gpio_hook = hook;
+}
+
+void sim_set_uid(uint32_t w0, uint32_t w1, uint32_t w2)
+{
+    sim_uid[0] = w0;
+    sim_uid[1] = w1;
+    sim_uid[2] = w2;
+}
+
+const SimStats_t *sim_stats(void)
+{
+    return &sim_counters;
+}
+
+/**
+ * @brief __enable_irq(): takes the interrupts that fell due while they were masked.
+ *        Handlers do not nest, so unmasking inside one only clears the mask.
+ */
+void sim_irq_unmask(void)
+{
+    sim_primask = 0;
+    if (!sim_in_isr) {
+        sim_service();
+    }
+}
+
+/* --------------------------------- Core and clocks -------------------------------- */
+
+void Error_Handler(void)
+{
+    fprintf(stderr, "sim: Error_Handler() at %llu us\n", (unsigned long long)sim_now);
+    abort();
+}
+
+uint32_t HAL_GetTick(void)
+{
+    return uwTick;
+}
+
+void HAL_SuspendTick(void)
+{
+    tick_enabled = false;
+}
+
+void HAL_ResumeTick(void)
+{
+    // The SysTick counter kept running, only its interrupt was off
+    if (!tick_enabled) {
+        tick_enabled = true;
+        tick_next_us = (sim_now / SIM_TICK_US + 1) * SIM_TICK_US;
+    }
+}
+
+uint32_t HAL_GetUIDw0(void)
+{
+    return sim_uid[0];
+}
+
+uint32_t HAL_GetUIDw1(void)
+{
+    return sim_uid[1];
+}
+
+uint32_t HAL_GetUIDw2(void)
+{
+    return sim_uid[2];
+}
+
+// Handlers never preempt code here, so masking a single source changes nothing
+void HAL_NVIC_EnableIRQ(IRQn_Type IRQn)
+{
+    (void)IRQn;
+}
+
+void HAL_NVIC_DisableIRQ(IRQn_Type IRQn)
+{
+    (void)IRQn;
+}
+
+void HAL_NVIC_SetPriority(IRQn_Type IRQn, uint32_t PreemptPriority, uint32_t SubPriority)
+{
+    (void)IRQn;
+    (void)PreemptPriority;
+    (void)SubPriority;
+}
+
+/**
+ * @brief WFI: moves the clock to the next interrupt, or to the end of the run if none comes
+ *        before it. The handler runs once the caller unmasks interrupts.
+ */
+void HAL_PWR_EnterSLEEPMode(uint32_t Regulator, uint8_t SLEEPEntry)
+{
+    uint64_t at_us;
+
+    (void)Regulator;
+    (void)SLEEPEntry;
+    if (sim_next_source(&at_us) == SIM_SRC_NONE || at_us > sim_run_end) {
+        at_us = sim_run_end;
+    } else {
+        sim_counters.wakeups++;
+    }
+    if (at_us > sim_now) {
+        sim_set_now(at_us);
+    }
+}
+
+/* -------------------------------------- GPIO --------------------------------------- */
+
+void HAL_GPIO_WritePin(GPIO_TypeDef *GPIOx, uint16_t GPIO_Pin, GPIO_PinState PinState)
+{
+    if (sim_gpio_hook != NULL) {
+        sim_gpio_hook(GPIOx, GPIO_Pin, PinState);
+    }
+}
+
+void HAL_GPIO_TogglePin(GPIO_TypeDef *GPIOx, uint16_t GPIO_Pin)
+{
+    (void)GPIOx;
+    (void)GPIO_Pin;
+}
+
+/* -------------------------------------- Flash -------------------------------------- */
+
+HAL_StatusTypeDef HAL_FLASH_Unlock(void)
+{
+    sim_flash_locked = false;
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_FLASH_Lock(void)
+{
+    sim_flash_locked = true;
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_FLASH_Program(uint32_t TypeProgram, uint32_t Address, uint64_t Data)
+{
+    uint8_t halfwords = (TypeProgram == FLASH_TYPEPROGRAM_WORD) ? 2 : 1;
+
+    if (sim_flash_locked || (Address & 1u) != 0 || Address < FLASH_BASE ||
+        Address + 2u * halfwords - 1 > FLASH_BANK1_END) {
+        return HAL_ERROR;
+    }
+    for (uint8_t i = 0; i < halfwords; i++) {
+        volatile uint16_t *cell = (volatile uint16_t *)(uintptr_t)(Address + 2u * i);
+        uint16_t value = (uint16_t)(Data >> (16 * i));
+        // Like the F1, a programmed half-word only takes zero (PGERR otherwise)
+        if (*cell != 0xFFFFu && value != 0) {
+            return HAL_ERROR;
+        }
+        *cell = value;
+    }
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_FLASHEx_Erase(FLASH_EraseInitTypeDef *pEraseInit, uint32_t *PageError)
+{
+    uint32_t end = pEraseInit->PageAddress + pEraseInit->NbPages * FLASH_PAGE_SIZE;
+
+    *PageError = 0xFFFFFFFFu;
+    if (sim_flash_locked || pEraseInit->TypeErase != FLASH_TYPEERASE_PAGES ||
+        pEraseInit->PageAddress < FLASH_BASE || end - 1 > FLASH_BANK1_END ||
+        (pEraseInit->PageAddress % FLASH_PAGE_SIZE) != 0) {
+        *PageError = pEraseInit->PageAddress;
+        return HAL_ERROR;
+    }
+    memset((void *)(uintptr_t)pEraseInit->PageAddress, 0xFF, end - pEraseInit->PageAddress);
+    return HAL_OK;
+}
+
+/* --------------------------------------- TIM ---------------------------------------- */
+
+HAL_StatusTypeDef HAL_TIM_Base_Start_IT(TIM_HandleTypeDef *htim)
+{
+    (void)htim;
+    tim_running = true;
+    tim_base_us = sim_now - tim_stopped_count;
+    tim_update_us = tim_base_us + SIM_TIM_PERIOD_US;
+    tim_it |= TIM_IT_UPDATE;
+    sim_tim_plan_cc1();
+    return HAL_OK;
+}
+
+uint32_t sim_tim_get_counter(void)
+{
+    return tim_running ? (uint32_t)((sim_now - tim_base_us) & 0xFFFFu) : tim_stopped_count;
+}
+
+void sim_tim_set_counter(uint32_t count)
+{
+    count &= 0xFFFFu;
+    if (!tim_running) {
+        tim_stopped_count = count;
+        return;
+    }
+    tim_base_us = sim_now - count;
+    tim_update_us = tim_base_us + SIM_TIM_PERIOD_US;
+    sim_tim_plan_cc1();
+}
+
+void sim_tim_set_compare(uint32_t compare)
+{
+    tim_ccr1 = compare & 0xFFFFu;
+    sim_tim_plan_cc1();
+}
+
+void sim_tim_enable_it(uint32_t it)
+{
+    tim_it |= it;
+    if (it & TIM_IT_CC1) {
+        sim_tim_plan_cc1();
+    }
+}
+
+void sim_tim_disable_it(uint32_t it)
+{
+    tim_it &= ~it;
+}
+
+bool sim_tim_get_flag(uint32_t flag)
+{
+    // An overflow that is due but whose interrupt has not run yet
+    if (flag == TIM_FLAG_UPDATE && tim_running && sim_now >= tim_update_us) {
+        return true;
+    }
+    return (tim_flags & flag) != 0;
+}
+
+void sim_tim_clear_flag(uint32_t flag)
+{
+    tim_flags &= ~flag;
+}
+
+/* --------------------------------------- UART --------------------------------------- */
+
+HAL_StatusTypeDef HAL_UART_Init(UART_HandleTypeDef *huart)
+{
+    if (huart->Init.BaudRate == 0) {
+        return HAL_ERROR;
+    }
+    if (huart == &huart1) {
+        sim_rx_plan(); // The idle line takes one character at the new rate
+    }
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_UART_Transmit_DMA(UART_HandleTypeDef *huart, const uint8_t *pData, uint16_t Size)
+{
+    uint8_t uart = (huart->Instance == USART1) ? 0 : 1;
+
+    if (sim_tx[uart].busy) {
+        return HAL_BUSY;
+    }
+    if (Size == 0) {
+        return HAL_ERROR;
+    }
+    sim_tx[uart].busy = true;
+    sim_tx[uart].done_us = sim_now + ((uint64_t)Size * SIM_UART_CHAR_BITS * 1000000u + huart->Init.BaudRate - 1) /
+                                     huart->Init.BaudRate;
+    sim_counters.tx_bytes[uart] += Size;
+    if (sim_tx_hook != NULL) {
+        sim_tx_hook(huart, pData, Size, sim_now);
+    }
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_UART_Receive_IT(UART_HandleTypeDef *huart, uint8_t *pData, uint16_t Size)
+{
+    if (huart != &huart2 || pData == NULL || Size == 0) {
+        return HAL_ERROR;
+    }
+    if (rx2_buf != NULL) {
+        return HAL_BUSY;
+    }
+    rx2_buf = pData;
+    rx2_size = Size;
+    rx2_pos = 0;
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_UART_AbortReceive(UART_HandleTypeDef *huart)
+{
+    if (huart == &huart1) {
+        rx_dma_on = false;
+        rx_since_idle = 0;
+        sim_rx_plan();
+    }
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_UART_AbortTransmit(UART_HandleTypeDef *huart)
+{
+    // The hook saw the whole transfer when it started, the rest of it is simply not timed
+    sim_tx[(huart->Instance == USART1) ? 0 : 1].busy = false;
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_UARTEx_ReceiveToIdle_DMA(UART_HandleTypeDef *huart, uint8_t *pData, uint16_t Size)
+{
+    if (huart != &huart1 || pData == NULL || Size == 0) {
+        return HAL_ERROR;
+    }
+    if (rx_dma_on) {
+        return HAL_BUSY;
+    }
+    rx_dma_buf = pData;
+    rx_dma_size = Size;
+    rx_dma_pos = 0;
+    rx_dma_on = true;
+    rx_since_idle = 0;
+    sim_rx_plan();
+    return HAL_OK;
+}
+
+HAL_UART_RxEventTypeTypeDef HAL_UARTEx_GetRxEventType(UART_HandleTypeDef *huart)
+{
+    return huart->RxEventType;
+}
@@ -0,0 +1,48 @@
+/**
+ * Control side of the simulated HAL: a virtual microsecond clock with the
+ * interrupts the application relies on (SysTick, TIM2 update and compare,
+ * USART1 receive-to-idle DMA, USART2 interrupt reception, UART transmit
+ * complete), plus hooks for the program driving it to inject received bytes
+ * and capture what is sent.
+ *
+ * Code runs in zero virtual time. The clock only moves when the application
+ * sleeps in low_power_idle(), straight to the next interrupt, and interrupts
+ * are serviced when it unmasks them again, as they would be on the target.
+ */
+#ifndef __HAL_SIM_H__
+#define __HAL_SIM_H__
+
+#include "main.h"
+
+// Called when the application starts a transmission; start_us is when the first bit leaves
+typedef void (*SimTxHook_t)(UART_HandleTypeDef *huart, const uint8_t *data, uint16_t len, uint64_t start_us);
+typedef void (*SimGpioHook_t)(GPIO_TypeDef *port, uint16_t pin, GPIO_PinState state);
+typedef void (*SimEventFn_t)(void *arg);
+
+typedef struct {
+    uint64_t wakeups;      // Sleeps ended by an interrupt
+    uint64_t interrupts;   // Interrupt handlers run, all sources
+    uint64_t ticks;        // SysTick interrupts, fewer than elapsed ms while suspended
+    uint64_t rx_events;    // HAL_UARTEx_RxEventCallback() calls for USART1
+    uint64_t rx_bytes;     // Bytes handed to the USART1 receive DMA
+    uint64_t rx_lost;      // Bytes that arrived with reception stopped
+    uint64_t tx_bytes[2];  // Bytes sent on USART1 and USART2
+} SimStats_t;
+
+void sim_init(void);
+void sim_boot(void);
+void sim_run_until(uint64_t end_us);
+void sim_run_for(uint64_t duration_us);
+uint64_t sim_now_us(void);
+
+bool sim_schedule(uint64_t at_us, SimEventFn_t fn, void *arg);
+uint64_t sim_uart_inject(const uint8_t *data, uint16_t len);
+uint64_t sim_console_inject(const uint8_t *data, uint16_t len);
+uint32_t sim_uart_char_us(const UART_HandleTypeDef *huart);
+
+void sim_set_tx_hook(SimTxHook_t hook);
+void sim_set_gpio_hook(SimGpioHook_t hook);
+void sim_set_uid(uint32_t w0, uint32_t w1, uint32_t w2);
+const SimStats_t *sim_stats(void);
+
+#endif /* __HAL_SIM_H__ */
@@ -0,0 +1,233 @@
+/**
+ * Host stand-in for the STM32F1 HAL: just the types, constants and calls the
+ * application modules use, backed by the simulated peripherals in hal_sim.c.
+ * main.h includes it by name, so with this directory on the include path the
+ * modules in Core/Src build unchanged for the host.
+ */
+#ifndef __STM32F1XX_HAL_H
+#define __STM32F1XX_HAL_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define __IO volatile
+
+typedef enum {
+    HAL_OK = 0x00U,
+    HAL_ERROR = 0x01U,
+    HAL_BUSY = 0x02U,
+    HAL_TIMEOUT = 0x03U
+} HAL_StatusTypeDef;
+
+/* ------------------------------- Core and clocks ------------------------------ */
+
+#define HSI_VALUE 8000000U
+extern uint32_t SystemCoreClock;
+extern volatile uint32_t uwTick;
+
+typedef enum {
+    TIM2_IRQn = 28,
+    USART1_IRQn = 37,
+    USART2_IRQn = 38,
+    EXTI9_5_IRQn = 23
+} IRQn_Type;
+
+// Interrupts are serviced when the CPU sleeps or unmasks them, never in the middle of code
+extern volatile uint32_t sim_primask;
+void sim_irq_unmask(void);
+
+#define __disable_irq() (sim_primask = 1U)
+#define __enable_irq() sim_irq_unmask()
+#define __get_PRIMASK() (sim_primask)
+#define __set_PRIMASK(mask) do { if ((mask) != 0U) { __disable_irq(); } else { __enable_irq(); } } while (0)
+#define __DMB() __asm__ volatile ("" ::: "memory")
+
+typedef struct {
+    volatile uint32_t DEMCR;
+} CoreDebug_Type;
+
+typedef struct {
+    volatile uint32_t CTRL;
+    volatile uint32_t CYCCNT; // Follows the simulated clock at SystemCoreClock
+} DWT_Type;
+
+extern CoreDebug_Type sim_core_debug;
+extern DWT_Type sim_dwt;
+#define CoreDebug (&sim_core_debug)
+#define DWT (&sim_dwt)
+#define CoreDebug_DEMCR_TRCENA_Msk (1UL << 24)
+#define DWT_CTRL_CYCCNTENA_Msk (1UL << 0)
+
+uint32_t HAL_GetTick(void);
+void HAL_SuspendTick(void);
+void HAL_ResumeTick(void);
+uint32_t HAL_GetUIDw0(void);
+uint32_t HAL_GetUIDw1(void);
+uint32_t HAL_GetUIDw2(void);
+void HAL_NVIC_EnableIRQ(IRQn_Type IRQn);
+void HAL_NVIC_DisableIRQ(IRQn_Type IRQn);
+void HAL_NVIC_SetPriority(IRQn_Type IRQn, uint32_t PreemptPriority, uint32_t SubPriority);
+
+#define PWR_MAINREGULATOR_ON 0x00000000U
+#define PWR_LOWPOWERREGULATOR_ON 0x00000001U
+#define PWR_SLEEPENTRY_WFI 0x01U
+#define PWR_STOPENTRY_WFI 0x01U
+
+void HAL_PWR_EnterSLEEPMode(uint32_t Regulator, uint8_t SLEEPEntry);
+
+/* ------------------------------------ GPIO ------------------------------------ */
+
+typedef struct {
+    uint8_t port;
+} GPIO_TypeDef;
+
+typedef enum {
+    GPIO_PIN_RESET = 0,
+    GPIO_PIN_SET
+} GPIO_PinState;
+
+extern GPIO_TypeDef sim_gpioa, sim_gpiob, sim_gpioc;
+#define GPIOA (&sim_gpioa)
+#define GPIOB (&sim_gpiob)
+#define GPIOC (&sim_gpioc)
+
+#define GPIO_PIN_0 ((uint16_t)0x0001)
+#define GPIO_PIN_1 ((uint16_t)0x0002)
+#define GPIO_PIN_2 ((uint16_t)0x0004)
+#define GPIO_PIN_3 ((uint16_t)0x0008)
+#define GPIO_PIN_6 ((uint16_t)0x0040)
+#define GPIO_PIN_7 ((uint16_t)0x0080)
+#define GPIO_PIN_9 ((uint16_t)0x0200)
+#define GPIO_PIN_12 ((uint16_t)0x1000)
+
+void HAL_GPIO_WritePin(GPIO_TypeDef *GPIOx, uint16_t GPIO_Pin, GPIO_PinState PinState);
+void HAL_GPIO_TogglePin(GPIO_TypeDef *GPIOx, uint16_t GPIO_Pin);
+
+/* ------------------------------------ Flash ----------------------------------- */
+
+// Mapped at the real addresses by sim_init(), so the store sees the same layout
+#define FLASH_BASE 0x08000000UL
+#define FLASH_BANK1_END 0x08007FFFUL
+#define FLASH_PAGE_SIZE 0x400U
+
+#define FLASH_TYPEERASE_PAGES 0x00U
+#define FLASH_TYPEPROGRAM_HALFWORD 0x01U
+#define FLASH_TYPEPROGRAM_WORD 0x02U
+#define FLASH_BANK_1 1U
+
+typedef struct {
+    uint32_t TypeErase;
+    uint32_t Banks;
+    uint32_t PageAddress;
+    uint32_t NbPages;
+} FLASH_EraseInitTypeDef;
+
+HAL_StatusTypeDef HAL_FLASH_Unlock(void);
+HAL_StatusTypeDef HAL_FLASH_Lock(void);
+HAL_StatusTypeDef HAL_FLASH_Program(uint32_t TypeProgram, uint32_t Address, uint64_t Data);
+HAL_StatusTypeDef HAL_FLASHEx_Erase(FLASH_EraseInitTypeDef *pEraseInit, uint32_t *PageError);
+
+/* ------------------------------------ DMA ------------------------------------- */
+
+typedef struct {
+    uint8_t channel;
+} DMA_HandleTypeDef;
+
+/* ------------------------------------ TIM ------------------------------------- */
+
+typedef struct {
+    uint8_t index;
+} TIM_TypeDef;
+
+extern TIM_TypeDef sim_tim2;
+#define TIM2 (&sim_tim2)
+
+typedef enum {
+    HAL_TIM_ACTIVE_CHANNEL_1 = 0x01U,
+    HAL_TIM_ACTIVE_CHANNEL_CLEARED = 0x00U
+} HAL_TIM_ActiveChannel;
+
+typedef struct {
+    TIM_TypeDef *Instance;
+    HAL_TIM_ActiveChannel Channel;
+} TIM_HandleTypeDef;
+
+#define TIM_CHANNEL_1 0x00000000U
+#define TIM_FLAG_UPDATE (1UL << 0)
+#define TIM_FLAG_CC1 (1UL << 1)
+#define TIM_IT_UPDATE (1UL << 0)
+#define TIM_IT_CC1 (1UL << 1)
+
+// The one TIM2 the application uses: a 1 MHz up-counter wrapping at 0xFFFF
+uint32_t sim_tim_get_counter(void);
+void sim_tim_set_counter(uint32_t count);
+void sim_tim_set_compare(uint32_t compare);
+void sim_tim_enable_it(uint32_t it);
+void sim_tim_disable_it(uint32_t it);
+bool sim_tim_get_flag(uint32_t flag);
+void sim_tim_clear_flag(uint32_t flag);
+
+#define __HAL_TIM_GET_COUNTER(__HANDLE__) sim_tim_get_counter()
+#define __HAL_TIM_SET_COUNTER(__HANDLE__, __COUNTER__) sim_tim_set_counter(__COUNTER__)
+#define __HAL_TIM_SET_COMPARE(__HANDLE__, __CHANNEL__, __COMPARE__) sim_tim_set_compare(__COMPARE__)
+#define __HAL_TIM_ENABLE_IT(__HANDLE__, __INTERRUPT__) sim_tim_enable_it(__INTERRUPT__)
+#define __HAL_TIM_DISABLE_IT(__HANDLE__, __INTERRUPT__) sim_tim_disable_it(__INTERRUPT__)
+#define __HAL_TIM_GET_FLAG(__HANDLE__, __FLAG__) sim_tim_get_flag(__FLAG__)
+#define __HAL_TIM_CLEAR_FLAG(__HANDLE__, __FLAG__) sim_tim_clear_flag(__FLAG__)
+
+HAL_StatusTypeDef HAL_TIM_Base_Start_IT(TIM_HandleTypeDef *htim);
+void HAL_TIM_PeriodElapsedCallback(TIM_HandleTypeDef *htim);
+void HAL_TIM_OC_DelayElapsedCallback(TIM_HandleTypeDef *htim);
+
+/* ------------------------------------ UART ------------------------------------ */
+
+typedef struct {
+    uint8_t index;
+} USART_TypeDef;
+
+extern USART_TypeDef sim_usart1, sim_usart2;
+#define USART1 (&sim_usart1)
+#define USART2 (&sim_usart2)
+
+typedef struct {
+    uint32_t BaudRate;
+    uint32_t WordLength;
+    uint32_t StopBits;
+    uint32_t Parity;
+    uint32_t Mode;
+    uint32_t HwFlowCtl;
+    uint32_t OverSampling;
+} UART_InitTypeDef;
+
+typedef uint32_t HAL_UART_RxEventTypeTypeDef;
+#define HAL_UART_RXEVENT_TC 0x00000000U
+#define HAL_UART_RXEVENT_HT 0x00000001U
+#define HAL_UART_RXEVENT_IDLE 0x00000002U
+
+typedef struct {
+    USART_TypeDef *Instance;
+    UART_InitTypeDef Init;
+    volatile HAL_UART_RxEventTypeTypeDef RxEventType;
+} UART_HandleTypeDef;
+
+#define UART_WORDLENGTH_8B 0x00000000U
+#define UART_STOPBITS_1 0x00000000U
+#define UART_PARITY_NONE 0x00000000U
+#define UART_MODE_TX_RX 0x0000000CU
+#define UART_HWCONTROL_NONE 0x00000000U
+#define UART_OVERSAMPLING_16 0x00000000U
+
+HAL_StatusTypeDef HAL_UART_Init(UART_HandleTypeDef *huart);
+HAL_StatusTypeDef HAL_UART_Transmit_DMA(UART_HandleTypeDef *huart, const uint8_t *pData, uint16_t Size);
+HAL_StatusTypeDef HAL_UART_Receive_IT(UART_HandleTypeDef *huart, uint8_t *pData, uint16_t Size);
+HAL_StatusTypeDef HAL_UART_AbortReceive(UART_HandleTypeDef *huart);
+HAL_StatusTypeDef HAL_UART_AbortTransmit(UART_HandleTypeDef *huart);
+HAL_StatusTypeDef HAL_UARTEx_ReceiveToIdle_DMA(UART_HandleTypeDef *huart, uint8_t *pData, uint16_t Size);
+HAL_UART_RxEventTypeTypeDef HAL_UARTEx_GetRxEventType(UART_HandleTypeDef *huart);
+void HAL_UART_TxCpltCallback(UART_HandleTypeDef *huart);
+void HAL_UART_RxCpltCallback(UART_HandleTypeDef *huart);
+void HAL_UART_ErrorCallback(UART_HandleTypeDef *huart);
+void HAL_UARTEx_RxEventCallback(UART_HandleTypeDef *huart, uint16_t Size);
+
+#endif /* __STM32F1XX_HAL_H */
@@ -0,0 +1,361 @@
+/**
+ * Simulated Zigbee module, see zigbee_module.h.
+ */
+#include "zigbee_module.h"
+#include "usart.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MODULE_BAUD_DEFAULT 115200 // Factory rate, and the rate after a reset unless keep_baud
+#define MODULE_CHAR_BITS 10
+#define MODULE_COMMAND_MAX 64
+#define MODULE_ANSWER_MAX 48
+#define MODULE_ANSWERS_PENDING 32  // Retries and pipelined commands can have many answers on their way
+#define MODULE_RESET_PORT GPIOA
+#define MODULE_RESET_PIN GPIO_PIN_0
+
+typedef struct {
+    bool busy;
+    uint32_t generation;  // Answers of a module that was reset since are never sent
+    uint32_t baud_after;  // Rate to switch to once the answer is out, 0 to stay
+    uint8_t len;
+    uint8_t data[MODULE_ANSWER_MAX];
+} ModuleAnswer_t;
+
+const ZigbeeModuleConfig_t zigbee_module_default = {
+    .latency_min_us = 2000,
+    .latency_max_us = 2000,
+    .nwk = 1,
+    .join_ms = 3000,
+    .boot_ms = 200,
+    .short_addr = 0x4653,
+    .id = 7,
+    .coordinator_ms = 20,
+};
+
+const char *const zigbee_module_cmd_names[ZIGBEE_MODULE_CMD_COUNT] = {
+    [ZIGBEE_MODULE_CMD_AT_MODE] = "+AT",
+    [ZIGBEE_MODULE_CMD_DEV] = "AT+DEV?",
+    [ZIGBEE_MODULE_CMD_NWK] = "AT+NWK?",
+    [ZIGBEE_MODULE_CMD_CH] = "AT+CH=",
+    [ZIGBEE_MODULE_CMD_JOIN] = "AT+JOIN",
+    [ZIGBEE_MODULE_CMD_ADDR] = "AT+ADDR?",
+    [ZIGBEE_MODULE_CMD_DSTADDR] = "AT+DSTADDR=",
+    [ZIGBEE_MODULE_CMD_DSTEP] = "AT+DSTEP=",
+    [ZIGBEE_MODULE_CMD_BAUD] = "AT+BAUD=",
+    [ZIGBEE_MODULE_CMD_EXIT] = "AT+EXIT",
+    [ZIGBEE_MODULE_CMD_LEAVE] = "AT+LEAVE",
+    [ZIGBEE_MODULE_CMD_GETID] = "GETID:",
+    [ZIGBEE_MODULE_CMD_OTHER] = "other",
+};
+
+static ZigbeeModuleConfig_t module_cfg;
+static ZigbeeModuleStats_t module_stats;
+static uint32_t module_rng = 1;           // xorshift32 state
+static uint32_t module_baud = MODULE_BAUD_DEFAULT;
+static bool module_at_mode = false;
+static bool module_in_reset = false;
+static uint64_t module_awake_us = 0;      // Deaf until then after a reset
+static uint32_t module_generation = 0;
+static uint8_t module_nwk_state = 0;      // Before flapping is applied
+static bool module_joining = false;
+static char module_command_buf[MODULE_COMMAND_MAX];
+static uint8_t module_command_len = 0;
+static ModuleAnswer_t module_answers[MODULE_ANSWERS_PENDING];
+
+static uint32_t module_random(void)
+{
+    module_rng ^= module_rng << 13;
+    module_rng ^= module_rng >> 17;
+    module_rng ^= module_rng << 5;
+    return module_rng;
+}
+
+static bool module_chance(uint16_t per_mille)
+{
+    return per_mille != 0 && module_random() % 1000 < per_mille;
+}
+
+static void module_answer_send(void *arg)
+{
+    ModuleAnswer_t *answer = arg;
+
+    if (answer->generation == module_generation) {
+        if (huart1.Init.BaudRate != module_baud) {
+            // At the wrong rate the application receives as many bytes, none of them right
+            for (uint8_t i = 0; i < answer->len; i++) {
+                answer->data[i] = (uint8_t)module_random();
+            }
+            module_stats.garbled++;
+        }
+        sim_uart_inject(answer->data, answer->len);
+        module_stats.answers++;
+        if (answer->baud_after != 0) {
+            module_baud = answer->baud_after;
+        }
+    }
+    answer->busy = false;
+}
+
+/**
+ * @brief Queues an answer line, or loses it, as configured.
+ * @param at_us When the command it answers ended.
+ * @param delay_us Extra time before the latency, for answers from the network.
+ * @param baud_after Rate the module switches to once it is out, 0 to stay.
+ * @return When the answer will start, 0 if it is lost.
+ */
+static uint64_t module_answer(const char *text, uint64_t at_us, uint32_t delay_us, uint32_t baud_after)
+{
+    ModuleAnswer_t *answer = NULL;
+
+    if (module_chance(module_cfg.drop_per_mille)) {
+        module_stats.dropped++;
+        return 0;
+    }
+    for (uint8_t i = 0; i < MODULE_ANSWERS_PENDING; i++) {
+        if (!module_answers[i].busy) {
+            answer = &module_answers[i];
+            break;
+        }
+    }
+    if (answer == NULL) {
+        module_stats.dropped++;
+        return 0;
+    }
+
+    answer->busy = true;
+    answer->generation = module_generation;
+    answer->baud_after = baud_after;
+    answer->len = (uint8_t)snprintf((char *)answer->data, sizeof(answer->data), "%s\r\n", text);
+    for (uint8_t i = 0; i < answer->len; i++) {
+        if (module_chance(module_cfg.corrupt_per_mille)) {
+            answer->data[i] ^= (uint8_t)(1u << (module_random() % 8));
+            module_stats.corrupted++;
+        }
+    }
+
+    uint32_t spread = module_cfg.latency_max_us - module_cfg.latency_min_us;
+    uint32_t latency = module_cfg.latency_min_us + ((spread != 0) ? module_random() % (spread + 1) : 0);
+    sim_schedule(at_us + delay_us + latency, module_answer_send, answer);
+    return at_us + delay_us + latency;
+}
+
+static void module_join_done(void *arg)
+{
+    if ((uintptr_t)arg != module_generation || !module_joining) {
+        return;
+    }
+    module_joining = false;
+    if (module_chance(module_cfg.join_fail_per_mille)) {
+        return;
+    }
+    module_nwk_state = 1;
+    module_stats.joins++;
+    module_stats.joined_us = sim_now_us();
+}
+
+uint8_t zigbee_module_nwk(void)
+{
+    if (module_nwk_state == 1 && module_cfg.flap_ms != 0 &&
+        (sim_now_us() - module_stats.joined_us) / 1000 / module_cfg.flap_ms % 2 == 1) {
+        return 2;
+    }
+    return module_nwk_state;
+}
+
+static ZigbeeModuleCmd_t module_command_kind(const char *cmd)
+{
+    for (uint8_t kind = 0; kind < ZIGBEE_MODULE_CMD_OTHER; kind++) {
+        const char *name = zigbee_module_cmd_names[kind];
+        size_t len = strlen(name);
+        // Names ending in '=' or ':' take an argument, the others must match exactly
+        bool prefix = (name[len - 1] == '=' || name[len - 1] == ':');
+        if (prefix ? strncmp(cmd, name, len) == 0 : strcmp(cmd, name) == 0) {
+            return (ZigbeeModuleCmd_t)kind;
+        }
+    }
+    return ZIGBEE_MODULE_CMD_OTHER;
+}
+
+/**
+ * @brief Acts on one command that ended at end_us.
+ */
+static void module_command(const char *cmd, uint64_t end_us)
+{
+    ZigbeeModuleCmd_t kind = module_command_kind(cmd);
+    const char *arg = cmd + strlen(zigbee_module_cmd_names[kind]);
+    char text[MODULE_ANSWER_MAX];
+
+    if (!module_at_mode) {
+        // Data mode: everything but the escape goes over the air
+        if (kind == ZIGBEE_MODULE_CMD_AT_MODE) {
+            module_stats.commands[kind]++;
+            module_at_mode = true;
+            module_answer("AT_MODE", end_us, 0, 0);
+        } else if (kind == ZIGBEE_MODULE_CMD_GETID) {
+            module_stats.commands[kind]++;
+            snprintf(text, sizeof(text), "0x%04X", module_cfg.short_addr);
+            if (zigbee_module_nwk() == 1 && strcmp(arg, text) == 0) {
+                snprintf(text, sizeof(text), "0x%04X:%02u", module_cfg.short_addr, module_cfg.id);
+                uint64_t answer_us = module_answer(text, end_us, module_cfg.coordinator_ms * 1000, 0);
+                if (answer_us != 0) {
+                    module_stats.id_given_us = answer_us;
+                }
+            }
+        }
+        return;
+    }
+
+    module_stats.commands[kind]++;
+    switch (kind) {
+    case ZIGBEE_MODULE_CMD_AT_MODE:
+        module_answer("AT_MODE", end_us, 0, 0);
+        break;
+    case ZIGBEE_MODULE_CMD_DEV:
+        module_answer("DEV=1", end_us, 0, 0);
+        break;
+    case ZIGBEE_MODULE_CMD_NWK:
+        snprintf(text, sizeof(text), "NWK=%u", zigbee_module_nwk());
+        module_answer(text, end_us, 0, 0);
+        break;
+    case ZIGBEE_MODULE_CMD_CH:
+        snprintf(text, sizeof(text), "CH=%s", arg);
+        module_answer(text, end_us, 0, 0);
+        break;
+    case ZIGBEE_MODULE_CMD_JOIN:
+        module_answer("OK", end_us, 0, 0);
+        if (zigbee_module_nwk() != 1 && !module_joining) {
+            module_joining = true;
+            sim_schedule(end_us + module_cfg.join_ms * 1000ull, module_join_done, (void *)(uintptr_t)module_generation);
+        }
+        break;
+    case ZIGBEE_MODULE_CMD_ADDR:
+        snprintf(text, sizeof(text), "ADDR=0x%04X", (zigbee_module_nwk() == 1) ? module_cfg.short_addr : 0xFFFE);
+        module_answer(text, end_us, 0, 0);
+        break;
+    case ZIGBEE_MODULE_CMD_DSTADDR:
+    case ZIGBEE_MODULE_CMD_DSTEP:
+        module_answer(cmd + 3, end_us, 0, 0); // Echoed without "AT+"
+        break;
+    case ZIGBEE_MODULE_CMD_BAUD: {
+        uint32_t baud = (uint32_t)strtoul(arg, NULL, 10);
+        if (module_cfg.refuse_baud || baud == 0) {
+            module_answer("ERROR", end_us, 0, 0);
+        } else {
+            snprintf(text, sizeof(text), "BAUD=%s", arg);
+            module_answer(text, end_us, 0, baud);
+        }
+        break;
+    }
+    case ZIGBEE_MODULE_CMD_EXIT:
+        module_at_mode = false;
+        module_answer("OK", end_us, 0, 0);
+        break;
+    case ZIGBEE_MODULE_CMD_LEAVE:
+        module_nwk_state = 0;
+        module_joining = false;
+        module_answer("OK", end_us, 0, 0);
+        break;
+    default:
+        module_answer("ERROR", end_us, 0, 0);
+        break;
+    }
+}
+
+/**
+ * @brief Powers the module up with the given behaviour.
+ * @param seed Seeds the latency, drop and corruption choices, any value.
+ */
+void zigbee_module_init(const ZigbeeModuleConfig_t *config, uint32_t seed)
+{
+    module_cfg = *config;
+    if (module_cfg.latency_max_us < module_cfg.latency_min_us) {
+        module_cfg.latency_max_us = module_cfg.latency_min_us;
+    }
+    memset(&module_stats, 0, sizeof(module_stats));
+    memset(module_answers, 0, sizeof(module_answers));
+    module_rng = seed * 2654435761u + 1;
+    module_rng = (module_rng != 0) ? module_rng : 1;
+    module_baud = MODULE_BAUD_DEFAULT;
+    module_at_mode = false;
+    module_in_reset = false;
+    module_awake_us = sim_now_us() + module_cfg.boot_ms * 1000ull;
+    module_generation++;
+    module_nwk_state = module_cfg.nwk;
+    module_joining = false;
+    module_command_len = 0;
+    if (module_nwk_state == 1) {
+        module_stats.joins = 1;
+        module_stats.joined_us = sim_now_us();
+    }
+}
+
+/**
+ * @brief Takes what the application sent on USART1. AT commands go out without a line
+ *        end, so the idle line after a transfer ends a command, as does a line end.
+ * @param baud The application's rate, garbage unless it matches the module's.
+ * @param start_us When the first byte started.
+ */
+void zigbee_module_on_tx(const uint8_t *data, uint16_t len, uint32_t baud, uint64_t start_us)
+{
+    if (module_in_reset || start_us < module_awake_us) {
+        return;
+    }
+    if (baud != module_baud) {
+        module_stats.garbled++;
+        return;
+    }
+    if (!module_at_mode) {
+        module_stats.data_bytes += len;
+    }
+
+    for (uint16_t i = 0; i <= len; i++) {
+        if (i == len || data[i] == '\n') {
+            while (module_command_len > 0 && module_command_buf[module_command_len - 1] == '\r') {
+                module_command_len--;
+            }
+            module_command_buf[module_command_len] = '\0';
+            if (module_command_len > 0) {
+                uint64_t end_us = start_us + ((uint64_t)((i < len) ? i + 1 : len) * MODULE_CHAR_BITS * 1000000u) / baud;
+                module_command(module_command_buf, end_us);
+            }
+            module_command_len = 0;
+        } else if (module_command_len < MODULE_COMMAND_MAX - 1) {
+            module_command_buf[module_command_len++] = (char)data[i];
+        }
+    }
+}
+
+/**
+ * @brief Follows the reset pin: held low the module is off, released it boots again in
+ *        data mode, at the factory rate unless keep_baud, still in its network.
+ */
+void zigbee_module_on_gpio(GPIO_TypeDef *port, uint16_t pin, GPIO_PinState state)
+{
+    if (port != MODULE_RESET_PORT || pin != MODULE_RESET_PIN) {
+        return;
+    }
+    if (state == GPIO_PIN_RESET) {
+        module_in_reset = true;
+        return;
+    }
+    if (!module_in_reset) {
+        return;
+    }
+    module_in_reset = false;
+    module_stats.resets++;
+    module_generation++;
+    module_at_mode = false;
+    module_joining = false;
+    module_command_len = 0;
+    if (!module_cfg.keep_baud) {
+        module_baud = MODULE_BAUD_DEFAULT;
+    }
+    module_awake_us = sim_now_us() + module_cfg.boot_ms * 1000ull;
+}
+
+const ZigbeeModuleStats_t *zigbee_module_stats(void)
+{
+    return &module_stats;
+}
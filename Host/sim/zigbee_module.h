@@ -0,0 +1,73 @@
+/**
+ * Simulated Zigbee module for the host build: the AT command set the startup
+ * sequence uses, the transparent data mode after AT+EXIT, and a coordinator
+ * answering GETID through it. Answers are delayed, dropped and corrupted as
+ * configured, and the network can be joined slowly or flap between NWK=1 and
+ * NWK=2, so startup can be run against the module misbehaving.
+ *
+ * Feed it what the application sends on USART1 with zigbee_module_on_tx()
+ * and the reset pin writes with zigbee_module_on_gpio(); it answers through
+ * sim_uart_inject().
+ */
+#ifndef __ZIGBEE_MODULE_H__
+#define __ZIGBEE_MODULE_H__
+
+#include "hal_sim.h"
+
+typedef enum {
+    ZIGBEE_MODULE_CMD_AT_MODE = 0, // "+AT"
+    ZIGBEE_MODULE_CMD_DEV,
+    ZIGBEE_MODULE_CMD_NWK,
+    ZIGBEE_MODULE_CMD_CH,
+    ZIGBEE_MODULE_CMD_JOIN,
+    ZIGBEE_MODULE_CMD_ADDR,
+    ZIGBEE_MODULE_CMD_DSTADDR,
+    ZIGBEE_MODULE_CMD_DSTEP,
+    ZIGBEE_MODULE_CMD_BAUD,
+    ZIGBEE_MODULE_CMD_EXIT,
+    ZIGBEE_MODULE_CMD_LEAVE,
+    ZIGBEE_MODULE_CMD_GETID,   // Data mode, answered by the coordinator
+    ZIGBEE_MODULE_CMD_OTHER,   // Unknown commands, answered "ERROR"
+    ZIGBEE_MODULE_CMD_COUNT
+} ZigbeeModuleCmd_t;
+
+typedef struct {
+    uint32_t latency_min_us;     // From the end of a command to the start of its answer
+    uint32_t latency_max_us;     // Each answer picks a latency in between
+    uint16_t drop_per_mille;     // Answers that never come
+    uint16_t corrupt_per_mille;  // Answer bytes with one bit flipped, per byte
+    uint8_t nwk;                 // Network state at power-up: 0 not joined, 1 joined, 2 lost
+    uint32_t join_ms;            // From AT+JOIN to being in the network
+    uint16_t join_fail_per_mille;// Joins that end up not joined
+    uint32_t flap_ms;            // Once joined, NWK alternates 1 and 2 every flap_ms, 0 never
+    bool refuse_baud;            // AT+BAUD= answers "ERROR"
+    bool keep_baud;              // A negotiated rate survives a reset
+    uint32_t boot_ms;            // Deaf after a reset
+    uint16_t short_addr;
+    uint16_t id;                 // Handed out by the coordinator on GETID
+    uint32_t coordinator_ms;     // GETID round trip through the network
+} ZigbeeModuleConfig_t;
+
+typedef struct {
+    uint32_t commands[ZIGBEE_MODULE_CMD_COUNT]; // Understood at the module's rate
+    uint32_t answers;       // Sent, corrupted or not
+    uint32_t dropped;       // Answers not sent
+    uint32_t corrupted;     // Bytes flipped
+    uint32_t garbled;       // Transfers lost to a baud rate mismatch, in either direction
+    uint32_t data_bytes;    // Sent by the application in data mode, poll replies included
+    uint32_t resets;
+    uint32_t joins;         // Networks joined, at power-up included
+    uint64_t joined_us;     // When the network was last joined
+    uint64_t id_given_us;   // When the coordinator last answered GETID, 0 never
+} ZigbeeModuleStats_t;
+
+extern const ZigbeeModuleConfig_t zigbee_module_default;
+extern const char *const zigbee_module_cmd_names[ZIGBEE_MODULE_CMD_COUNT];
+
+void zigbee_module_init(const ZigbeeModuleConfig_t *config, uint32_t seed);
+void zigbee_module_on_tx(const uint8_t *data, uint16_t len, uint32_t baud, uint64_t start_us);
+void zigbee_module_on_gpio(GPIO_TypeDef *port, uint16_t pin, GPIO_PinState state);
+uint8_t zigbee_module_nwk(void);
+const ZigbeeModuleStats_t *zigbee_module_stats(void);
+
+#endif /* __ZIGBEE_MODULE_H__ */
@@ -0,0 +1,275 @@
+/**
+ * Host build of the application: Core/Src runs unchanged on the simulated HAL
+ * in sim/, boots against the simulated Zigbee module, then answers MBMP polls as
+ * fast as the host can feed them. Checks that every reply goes out at the
+ * start of its slot and reports the polls handled per second of host time,
+ * which makes the whole receive/parse/schedule/reply path visible to perf.
+ *
+ * Build and run from this directory:
+ *   make zigbee_host && ./zigbee_host -n 200000
+ *   perf record -g ./zigbee_host -n 1000000 -b && perf report
+ *
+ * Options: -n polls, -b binary bitmap frames instead of hex lines, -i our ID
+ * as handed out by GETID (1-512), -s random seed, -l file to capture the
+ * USART2 log for zigbee_log_decode, -p send the profiler's 'p' command on
+ * USART2 after the polls and print the table it logs, -q send 'h' and print
+ * the reply latency histogram the application kept. The host build times its
+ * regions in TSC ticks, not target cycles.
+ *
+ * Throughput is about 130k-250k polls/s on a desktop core (4-8 us per poll),
+ * well short of millions. A gprof run of 200000 hex polls puts about half the
+ * time in the simulation itself: injecting each poll and planning its DMA
+ * events, some 28 interrupt mask/unmask pairs per poll, picking the next
+ * virtual-time event, and host_tx checking every reply. Nearly a third is the
+ * application's own per-byte RX path, 135 mbmp_stream_feed() calls per hex
+ * poll. Two log records per poll are written and parsed back for the rest.
+ * None of that changes the firmware, so the figure compares builds; it is not
+ * a target rate.
+ */
+#include "hal_sim.h"
+#include "mbmp.h"
+#include "usart.h"
+#include "zigbee_log.h"
+#include "zigbee_module.h"
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define HOST_BOOT_LIMIT_US 30000000u // Startup must be done by then
+#define HOST_SLOT_US 10000u          // ZIGBEE_INTERVAL_RESPONSE_US of the application
+
+// Our poll replies, seen on USART1 once the coordinator handed out the ID
+static uint32_t reply_count = 0;
+static uint64_t reply_at_us = 0;
+static FILE *log_capture = NULL;
+static bool log_print_profile = false;
+static bool log_print_latency = false;
+static uint8_t log_record[3 + 255 + 1];
+static uint16_t log_pos = 0;
+
+static bool host_id_given(void)
+{
+    return zigbee_module_stats()->id_given_us != 0 && sim_now_us() >= zigbee_module_stats()->id_given_us;
+}
+
+/**
+ * @brief Follows the binary log on USART2 record by record and prints the answers to
+ *        the console commands.
+ */
+static void host_log_byte(uint8_t byte)
+{
+    if (log_pos == 0 && byte != ZB_LOG_SYNC) {
+        return;
+    }
+    log_record[log_pos++] = byte;
+    if (log_pos < 3 || log_pos < 3 + log_record[2] + 1) {
+        return;
+    }
+    log_pos = 0;
+
+    uint8_t len = log_record[2];
+    uint8_t check = log_record[1] ^ len;
+    for (uint16_t i = 0; i < len; i++) {
+        check ^= log_record[3 + i];
+    }
+    if (check != log_record[3 + len]) {
+        return;
+    }
+    uint32_t args[4];
+    memcpy(args, &log_record[3], (len < sizeof(args)) ? len : sizeof(args));
+    if (log_record[1] == ZB_MSG_PROF_REGION && len >= 16 && log_print_profile) {
+        printf("  %-14.*s %10u runs  min %8u  avg %8u  max %8u\n", len - 16, (const char *)&log_record[3 + 16],
+               args[3], args[0], args[1], args[2]);
+    } else if (log_record[1] == ZB_MSG_LATENCY_TOTALS && len >= 16 && log_print_latency) {
+        printf("  %u replies, late by %u us on average, %u us at most, %u early\n", args[0], args[1], args[2],
+               args[3]);
+    } else if (log_record[1] == ZB_MSG_LATENCY_BUCKET && len >= 8 && log_print_latency) {
+        printf("  from %6u us %10u\n", args[0], args[1]);
+    }
+}
+
+static void host_tx(UART_HandleTypeDef *huart, const uint8_t *data, uint16_t len, uint64_t start_us)
+{
+    if (huart == &huart2) {
+        if (log_capture != NULL) {
+            fwrite(data, 1, len, log_capture);
+        }
+        for (uint16_t i = 0; i < len; i++) {
+            host_log_byte(data[i]);
+        }
+        return;
+    }
+    if (host_id_given()) {
+        reply_count++;
+        reply_at_us = start_us;
+    }
+    zigbee_module_on_tx(data, len, huart->Init.BaudRate, start_us);
+}
+
+/* ---------------------------------- Polls ----------------------------------- */
+
+static uint16_t poll_build(const uint8_t *bitmap, bool binary, uint8_t *poll, uint16_t max_len)
+{
+    static const char digits[] = "0123456789abcdef";
+
+    if (binary) {
+        return (uint16_t)mbmp_frame_encode(MBMP_FRAME_BITMAP, bitmap, MBMP_MAX_BITMAP_SIZE, poll, max_len);
+    }
+    uint16_t len = 0;
+    memcpy(poll, "MBMP:", 5);
+    len = 5;
+    for (int i = 0; i < MBMP_MAX_BITMAP_SIZE; i++) {
+        poll[len++] = (uint8_t)digits[bitmap[i] >> 4];
+        poll[len++] = (uint8_t)digits[bitmap[i] & 0x0F];
+    }
+    poll[len++] = '\r';
+    poll[len++] = '\n';
+    return len;
+}
+
+static double host_now_s(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+int main(int argc, char **argv)
+{
+    uint32_t polls = 200000;
+    bool binary = false;
+    int self_id = 7;
+    unsigned seed = 1;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "n:bi:s:l:pq")) != -1) {
+        switch (opt) {
+        case 'n':
+            polls = (uint32_t)strtoul(optarg, NULL, 10);
+            break;
+        case 'b':
+            binary = true;
+            break;
+        case 'i':
+            self_id = atoi(optarg);
+            break;
+        case 's':
+            seed = (unsigned)strtoul(optarg, NULL, 10);
+            break;
+        case 'l':
+            log_capture = fopen(optarg, "wb");
+            if (log_capture == NULL) {
+                perror(optarg);
+                return 1;
+            }
+            break;
+        case 'p':
+            log_print_profile = true;
+            break;
+        case 'q':
+            log_print_latency = true;
+            break;
+        default:
+            fprintf(stderr, "usage: %s [-n polls] [-b] [-i id] [-s seed] [-l logfile] [-p] [-q]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (self_id < 1 || self_id > MBMP_MAX_BITMAP_SIZE * 8) {
+        fprintf(stderr, "ID must be 1 to %d\n", MBMP_MAX_BITMAP_SIZE * 8);
+        return 1;
+    }
+    srand(seed);
+
+    ZigbeeModuleConfig_t module = zigbee_module_default;
+    module.id = (uint16_t)self_id;
+    sim_init();
+    zigbee_module_init(&module, seed);
+    sim_set_tx_hook(host_tx);
+    sim_set_gpio_hook(zigbee_module_on_gpio);
+    sim_boot();
+
+    // Boot: baud probing, the AT handshake and GETID, all in virtual time
+    while (!host_id_given() && sim_now_us() < HOST_BOOT_LIMIT_US) {
+        sim_run_for(1000);
+    }
+    if (!host_id_given()) {
+        fprintf(stderr, "startup did not finish in %u ms\n", HOST_BOOT_LIMIT_US / 1000);
+        return 1;
+    }
+    sim_run_for(50000); // The ID answer reaching the application
+    printf("startup done at %.1f ms virtual, USART1 at %lu baud, ID %d\n",
+           sim_now_us() / 1000.0, (unsigned long)huart1.Init.BaudRate, self_id);
+
+    uint8_t bitmap[MBMP_MAX_BITMAP_SIZE];
+    uint8_t poll[5 + 2 * MBMP_MAX_BITMAP_SIZE + 2];
+    uint32_t char_us = sim_uart_char_us(&huart1);
+    int64_t offset_min = INT64_MAX;
+    int64_t offset_max = INT64_MIN;
+    int64_t offset_sum = 0;
+    uint32_t errors = 0;
+    uint64_t poll_bytes = 0;
+
+    double t0 = host_now_s();
+    for (uint32_t i = 0; i < polls; i++) {
+        // A random half of the network, us included
+        for (int b = 0; b < MBMP_MAX_BITMAP_SIZE; b++) {
+            bitmap[b] = (uint8_t)rand();
+        }
+        bitmap[(self_id - 1) / 8] |= (uint8_t)(1u << ((self_id - 1) % 8));
+        int slot = mbmp_get_response_slot(bitmap, MBMP_MAX_BITMAP_SIZE * 8, self_id);
+        uint16_t len = poll_build(bitmap, binary, poll, sizeof(poll));
+
+        uint32_t replies = reply_count;
+        uint64_t end_us = sim_uart_inject(poll, len);
+        uint64_t due_us = end_us + (uint64_t)slot * HOST_SLOT_US;
+        poll_bytes += len;
+        sim_run_until(due_us + char_us + 2);
+
+        // The application times the poll end from whole-microsecond character times, so the
+        // reply may be off by a character at most; slot 0 also waits for the idle line event.
+        int64_t offset = (int64_t)(reply_at_us - due_us);
+        if (reply_count != replies + 1 || offset < -(int64_t)char_us || offset > (int64_t)char_us + 2) {
+            if (errors++ < 10) {
+                printf("poll %u: slot %d, %u replies, at %+lld us\n", i, slot, reply_count - replies,
+                       (long long)offset);
+            }
+            continue;
+        }
+        offset_sum += offset;
+        offset_min = (offset < offset_min) ? offset : offset_min;
+        offset_max = (offset > offset_max) ? offset : offset_max;
+    }
+    double t1 = host_now_s();
+
+    const SimStats_t *stats = sim_stats();
+    printf("%u %s polls, %llu bytes: %.0f polls/s, %.0f ns per poll (%.1f MB/s received)\n",
+           polls, binary ? "binary" : "hex", (unsigned long long)poll_bytes, polls / (t1 - t0),
+           (t1 - t0) * 1e9 / polls, poll_bytes / (t1 - t0) / 1e6);
+    if (polls != errors) {
+        printf("reply against slot start: min %+lld us, avg %+.1f us, max %+lld us\n", (long long)offset_min,
+               (double)offset_sum / (polls - errors), (long long)offset_max);
+    }
+    printf("%u polls answered wrong\n", errors);
+    printf("virtual %.1f s, %llu wake-ups, %llu interrupts, %llu RX events, %llu log bytes\n",
+           sim_now_us() / 1e6, (unsigned long long)stats->wakeups, (unsigned long long)stats->interrupts,
+           (unsigned long long)stats->rx_events, (unsigned long long)stats->tx_bytes[1]);
+
+    if (log_print_profile) {
+        // Asked for like on the target, the table comes back in the log
+        printf("profile, TSC ticks per region:\n");
+        uint64_t end_us = sim_console_inject((const uint8_t *)"p", 1);
+        sim_run_until(end_us + 100000);
+    }
+    if (log_print_latency) {
+        printf("reply latency, slot timer to DMA start, as the application measured it (see latency.h):\n");
+        uint64_t end_us = sim_console_inject((const uint8_t *)"h", 1);
+        sim_run_until(end_us + 100000);
+    }
+    if (log_capture != NULL) {
+        fclose(log_capture);
+    }
+    return errors != 0;
+}
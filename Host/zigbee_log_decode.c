@@ -0,0 +1,120 @@
+/**
+ * Host-side decoder for the binary USART2 debug log (see Core/Inc/zigbee_log.h).
+ * Reads a raw capture from a file, or stdin, and prints one text line per record.
+ * Bytes between records are skipped. A record with a bad checksum is taken for a sync byte
+ * inside other data, and the search goes on from the byte after it.
+ *
+ * Build and run from this directory:
+ *   gcc -O2 -I../Core/Inc zigbee_log_decode.c -o zigbee_log_decode
+ *   stty -F /dev/ttyUSB0 115200 raw && ./zigbee_log_decode /dev/ttyUSB0
+ */
+#include "zigbee_log.h"
+#include <stdio.h>
+#include <string.h>
+
+static const char *const log_formats[ZB_MSG_COUNT] = {
+#define ZB_LOG_MSG(id, format) [id] = format,
+#include "zigbee_log_msgs.h"
+#undef ZB_LOG_MSG
+};
+
+static void print_record(uint8_t id, const uint8_t *payload, uint8_t len)
+{
+    const char *format;
+    uint8_t pos = 0;
+
+    if (id >= ZB_MSG_COUNT) {
+        printf("<unknown message %u, %u bytes>\n", id, len);
+        return;
+    }
+
+    for (format = log_formats[id]; *format != '\0'; format++) {
+        if (format[0] != '%' || format[1] == '\0') {
+            putchar(*format);
+            continue;
+        }
+        format++;
+        if (*format == 's') {
+            fwrite(&payload[pos], 1, len - pos, stdout);
+            pos = len;
+        } else if (*format == 'd' || *format == 'u' || *format == 'x') {
+            uint32_t value = 0;
+            if (pos + 4 <= len) {
+                value = (uint32_t)payload[pos] | ((uint32_t)payload[pos + 1] << 8) |
+                        ((uint32_t)payload[pos + 2] << 16) | ((uint32_t)payload[pos + 3] << 24);
+                pos += 4;
+            }
+            if (*format == 'd') {
+                printf("%d", (int)(int32_t)value);
+            } else {
+                printf(*format == 'u' ? "%u" : "%x", (unsigned)value);
+            }
+        } else {
+            putchar(*format);
+        }
+    }
+    putchar('\n');
+    fflush(stdout);
+}
+
+/**
+ * Decodes the record at the start of the buffer.
+ * @return Bytes used from the buffer: the whole record, 1 to drop a byte that is not the
+ *         start of a valid record, or 0 when more bytes are needed to decide.
+ */
+static size_t parse_record(const uint8_t *buf, size_t fill)
+{
+    uint8_t check;
+    size_t len;
+
+    if (buf[0] != ZB_LOG_SYNC) {
+        return 1;
+    }
+    if (fill < 3) {
+        return 0;
+    }
+    len = buf[2];
+    if (fill < 3 + len + 1) {
+        return 0;
+    }
+    check = buf[1] ^ buf[2];
+    for (size_t i = 0; i < len; i++) {
+        check ^= buf[3 + i];
+    }
+    if (check != buf[3 + len]) {
+        // The sync byte was part of the data, a real record may start inside these bytes
+        fprintf(stderr, "checksum error, resyncing\n");
+        return 1;
+    }
+    print_record(buf[1], &buf[3], (uint8_t)len);
+    return 3 + len + 1;
+}
+
+int main(int argc, char **argv)
+{
+    FILE *in = stdin;
+    uint8_t buf[3 + 255 + 1];
+    size_t fill = 0;
+    int c;
+
+    if (argc > 1 && (in = fopen(argv[1], "rb")) == NULL) {
+        perror(argv[1]);
+        return 1;
+    }
+
+    // Byte by byte so a live serial port is decoded as it arrives
+    while ((c = fgetc(in)) != EOF) {
+        size_t used;
+
+        buf[fill++] = (uint8_t)c;
+        while (fill > 0 && (used = parse_record(buf, fill)) != 0) {
+            fill -= used;
+            memmove(buf, &buf[used], fill);
+        }
+    }
+
+    if (in != stdin) {
+        fclose(in);
+    }
+    return 0;
+}
@@ -0,0 +1,232 @@
+/**
+ * Checks the slave reply builder (Core/Src/zigbee_reply.c) by decoding every
+ * frame it builds: header, sequence number, records and CRC. Covers records
+ * that wrap around the queue, frames that only take part of the backlog, the
+ * sequence going up once per frame sent, and a frame rebuilt after a slot
+ * went by unsent.
+ *
+ * Build and run from this directory:
+ *   make zigbee_reply_test && ./zigbee_reply_test
+ */
+#include "zigbee_reply.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define TEST_ID 0x0123
+
+#define CHECK(cond)                                                         \
+    do {                                                                    \
+        if (!(cond)) {                                                      \
+            printf("FAILED line %d: %s\n", __LINE__, #cond);                \
+            exit(1);                                                        \
+        }                                                                   \
+    } while (0)
+
+typedef struct {
+    uint16_t id;
+    uint8_t seq;
+    uint8_t count;
+    uint8_t lens[ZIGBEE_REPLY_MAX_FRAME];
+    const uint8_t *records[ZIGBEE_REPLY_MAX_FRAME];
+} Reply_t;
+
+static uint8_t next_seq = 0;      // What the next frame sent must carry
+static uint32_t frames_sent = 0;
+
+/**
+ * @brief Decodes a reply frame the way the master does, and checks its framing.
+ */
+static void reply_decode(const uint8_t *frame, uint16_t frame_len, Reply_t *reply)
+{
+    uint16_t pos = 3 + ZIGBEE_REPLY_HEADER_LEN;
+
+    CHECK(frame_len >= MBMP_FRAME_OVERHEAD + ZIGBEE_REPLY_HEADER_LEN);
+    CHECK(frame[0] == MBMP_FRAME_SYNC);
+    CHECK(frame[1] == MBMP_FRAME_REPLY);
+    CHECK(frame[2] + MBMP_FRAME_OVERHEAD == frame_len);
+    CHECK(mbmp_crc8(0, &frame[1], (uint16_t)(frame[2] + 2)) == frame[frame_len - 1]);
+
+    reply->id = (uint16_t)(frame[3] | (frame[4] << 8));
+    reply->seq = frame[5];
+    reply->count = frame[6];
+    for (uint8_t i = 0; i < reply->count; i++) {
+        CHECK(pos < frame_len - 1);
+        reply->lens[i] = frame[pos];
+        reply->records[i] = &frame[pos + 1];
+        pos += 1 + frame[pos];
+    }
+    CHECK(pos == frame_len - 1); // Nothing between the last record and the CRC
+}
+
+/**
+ * @brief Fills a record with bytes that tell it apart from its neighbours.
+ */
+static void record_fill(uint8_t *record, uint8_t len, uint32_t number)
+{
+    for (uint8_t i = 0; i < len; i++) {
+        record[i] = (uint8_t)(number * 31 + i);
+    }
+}
+
+/**
+ * @brief Builds, decodes and sends one frame, checking it holds the oldest records.
+ * @param max_len The room in the slot.
+ * @param first Number of the oldest queued record.
+ * @param lens Lengths of the queued records, oldest first.
+ * @param queued How many are queued.
+ * @return How many records the frame took.
+ */
+static uint8_t send_frame(uint16_t max_len, uint32_t first, const uint8_t *lens, uint16_t queued)
+{
+    uint8_t frame[ZIGBEE_REPLY_MAX_FRAME];
+    uint8_t expected[ZIGBEE_REPLY_RECORD_MAX];
+    Reply_t reply;
+    uint16_t frame_len = zigbee_reply_build(TEST_ID, max_len, frame);
+
+    CHECK(frame_len != 0 && frame_len <= max_len);
+    reply_decode(frame, frame_len, &reply);
+    CHECK(reply.id == TEST_ID);
+    CHECK(reply.seq == next_seq);
+    CHECK(reply.count >= 1 && reply.count <= queued);
+    for (uint8_t i = 0; i < reply.count; i++) {
+        CHECK(reply.lens[i] == lens[i]);
+        record_fill(expected, lens[i], first + i);
+        CHECK(memcmp(reply.records[i], expected, lens[i]) == 0);
+    }
+    // The next record would not have fitted
+    if (reply.count < queued) {
+        CHECK(frame_len + 1 + lens[reply.count] > max_len);
+    }
+
+    CHECK(zigbee_reply_pending() == queued); // Still queued until sent
+    zigbee_reply_commit();
+    CHECK(zigbee_reply_pending() == queued - reply.count);
+    next_seq++;
+    frames_sent++;
+    return reply.count;
+}
+
+static void test_empty(void)
+{
+    uint8_t frame[ZIGBEE_REPLY_MAX_FRAME];
+
+    CHECK(zigbee_reply_pending() == 0);
+    CHECK(zigbee_reply_build(TEST_ID, sizeof(frame), frame) == 0);
+    zigbee_reply_commit(); // Nothing built, nothing dropped, no sequence number used
+}
+
+static void test_push_limits(void)
+{
+    uint8_t record[ZIGBEE_REPLY_RECORD_MAX + 1];
+    uint8_t frame[ZIGBEE_REPLY_MAX_FRAME];
+    uint8_t lens[1] = { ZIGBEE_REPLY_RECORD_MAX };
+
+    record_fill(record, sizeof(record), 0);
+    CHECK(!zigbee_reply_push(record, 0));
+    CHECK(!zigbee_reply_push(record, ZIGBEE_REPLY_RECORD_MAX + 1));
+    CHECK(zigbee_reply_pending() == 0);
+
+    // The longest record fills a whole frame, and no shorter one
+    CHECK(zigbee_reply_push(record, ZIGBEE_REPLY_RECORD_MAX));
+    CHECK(zigbee_reply_build(TEST_ID, ZIGBEE_REPLY_MAX_FRAME - 1, frame) == 0);
+    CHECK(send_frame(ZIGBEE_REPLY_MAX_FRAME, 0, lens, 1) == 1);
+}
+
+static void test_partial_fit(void)
+{
+    static const uint8_t lens[] = { 10, 20, 5, 30, 1, 7 };
+    uint8_t record[ZIGBEE_REPLY_RECORD_MAX];
+    uint16_t queued = sizeof(lens);
+    uint32_t first = 0;
+
+    for (uint16_t i = 0; i < queued; i++) {
+        record_fill(record, lens[i], i);
+        CHECK(zigbee_reply_push(record, lens[i]));
+    }
+
+    // A slot too short for anything
+    CHECK(zigbee_reply_build(TEST_ID, MBMP_FRAME_OVERHEAD + ZIGBEE_REPLY_HEADER_LEN, record) == 0);
+
+    // A short slot takes the oldest records only, the rest go out in later frames
+    while (queued > 0) {
+        uint8_t sent = send_frame(40, first, &lens[first], queued);
+        first += sent;
+        queued -= sent;
+    }
+    CHECK(zigbee_reply_pending() == 0);
+}
+
+static void test_rebuild(void)
+{
+    uint8_t record[8];
+    uint8_t first[ZIGBEE_REPLY_MAX_FRAME];
+    uint8_t again[ZIGBEE_REPLY_MAX_FRAME];
+    uint8_t lens[2] = { 8, 8 };
+
+    record_fill(record, 8, 100);
+    CHECK(zigbee_reply_push(record, 8));
+
+    // The slot went by without the frame being sent: the next build repeats it, same sequence
+    uint16_t first_len = zigbee_reply_build(TEST_ID, sizeof(first), first);
+    CHECK(first_len != 0);
+    record_fill(record, 8, 101);
+    CHECK(zigbee_reply_push(record, 8));
+    uint16_t again_len = zigbee_reply_build(TEST_ID, first_len, again);
+    CHECK(again_len == first_len && memcmp(first, again, first_len) == 0);
+
+    // With room, the rebuilt frame also takes what was queued since
+    CHECK(send_frame(ZIGBEE_REPLY_MAX_FRAME, 100, lens, 2) == 2);
+    zigbee_reply_commit(); // A second commit drops nothing more
+    CHECK(zigbee_reply_pending() == 0);
+}
+
+static void test_wraparound(void)
+{
+    uint8_t record[ZIGBEE_REPLY_RECORD_MAX];
+    uint8_t lens[64];
+    uint32_t number = 1000;
+    uint32_t first = number;
+    uint16_t queued = 0;
+    uint32_t bytes = 0;
+
+    srand(1);
+    // Far more than the queue holds, so records keep wrapping around its end
+    while (bytes < 20000) {
+        uint8_t len = (uint8_t)(1 + rand() % ZIGBEE_REPLY_RECORD_MAX);
+
+        record_fill(record, len, number);
+        if (queued < sizeof(lens) && zigbee_reply_push(record, len)) {
+            lens[queued++] = len;
+            number++;
+            bytes += len;
+            continue;
+        }
+        // Full: drain a frame with room for at least the oldest record, then try again
+        uint16_t min_len = MBMP_FRAME_OVERHEAD + ZIGBEE_REPLY_HEADER_LEN + 1 + lens[0];
+        uint16_t max_len = (uint16_t)(min_len + rand() % (ZIGBEE_REPLY_MAX_FRAME - min_len + 1));
+        uint8_t sent = send_frame(max_len, first, lens, queued);
+        memmove(lens, &lens[sent], queued - sent);
+        first += sent;
+        queued -= sent;
+    }
+    while (queued > 0) {
+        uint8_t sent = send_frame(ZIGBEE_REPLY_MAX_FRAME, first, lens, queued);
+        memmove(lens, &lens[sent], queued - sent);
+        first += sent;
+        queued -= sent;
+    }
+    CHECK(zigbee_reply_pending() == 0);
+    CHECK(frames_sent > 256); // The sequence number went around
+}
+
+int main(void)
+{
+    test_empty();
+    test_push_limits();
+    test_partial_fit();
+    test_rebuild();
+    test_wraparound();
+    printf("zigbee_reply: all checks passed, %u frames\n", frames_sent);
+    return 0;
+}
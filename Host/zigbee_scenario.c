@@ -0,0 +1,370 @@
+/**
+ * Startup scenarios against the simulated Zigbee module: the application boots
+ * on the simulated HAL while the module answers late, loses or garbles answers,
+ * joins slowly or flaps between NWK=1 and NWK=2. Each scenario runs with
+ * several seeds and reports the time to joined (startup complete, as logged
+ * by the application), the time to an ID, and the retries it took: timeouts
+ * and failures from the application's own log, and commands the module saw.
+ *
+ * The application keeps its state in statics and boots once per process, so
+ * every run is a forked child reporting back through a pipe. Warm scenarios
+ * boot with the flash a cold boot of their own, one fork further down, left.
+ *
+ * Build and run from this directory:
+ *   make zigbee_scenario && ./zigbee_scenario
+ *   ./zigbee_scenario -s lossy -r 50 -v
+ *
+ * Options: -s scenario name (all by default), -r runs per scenario, -t limit
+ * in virtual seconds per run, -v one line per run, -l list the scenarios.
+ */
+#include "hal_sim.h"
+#include "usart.h"
+#include "zigbee_log.h"
+#include "zigbee_module.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+typedef struct {
+    const char *name;
+    const char *description;
+    ZigbeeModuleConfig_t module;
+    bool warm;            // Boots with the parameters a cold boot saved in flash
+} Scenario_t;
+
+typedef struct {
+    bool joined;          // Startup complete
+    bool got_id;          // From GETID, or from flash on a warm boot
+    bool warm_boot;       // The saved parameters were taken, GETID skipped
+    uint32_t joined_ms;   // From reset, as the application logged it
+    uint32_t id_ms;       // When the application logged its ID
+    uint32_t log_counts[ZB_MSG_COUNT];
+    ZigbeeModuleStats_t module;
+} ScenarioResult_t;
+
+static const char *const log_names[ZB_MSG_COUNT] = {
+#define ZB_LOG_MSG(id, format) [id] = #id,
+#include "zigbee_log_msgs.h"
+#undef ZB_LOG_MSG
+};
+
+#define SCENARIO_MODULE(...) { .latency_min_us = 2000, .latency_max_us = 2000, .nwk = 1, .join_ms = 3000, \
+                               .boot_ms = 200, .short_addr = 0x4653, .id = 7, .coordinator_ms = 20, __VA_ARGS__ }
+
+static const Scenario_t scenarios[] = {
+    { "clean", "joined module, answers in 2 ms", SCENARIO_MODULE() },
+    { "slow", "answers take 100 to 900 ms", SCENARIO_MODULE(.latency_min_us = 100000, .latency_max_us = 900000) },
+    { "lossy", "10% of answers lost, 0.5% of bytes corrupted",
+      SCENARIO_MODULE(.drop_per_mille = 100, .corrupt_per_mille = 5) },
+    { "unjoined", "not in a network, joining takes 4 s", SCENARIO_MODULE(.nwk = 0, .join_ms = 4000) },
+    { "join_fail", "not in a network, half the joins fail", SCENARIO_MODULE(.nwk = 0, .join_ms = 2000, .join_fail_per_mille = 500) },
+    { "lost", "network lost at power-up, rejoin takes 1.5 s", SCENARIO_MODULE(.nwk = 2, .join_ms = 1500) },
+    { "flap", "NWK alternates 1 and 2 every 700 ms", SCENARIO_MODULE(.flap_ms = 700) },
+    { "no_baud", "module refuses AT+BAUD=", SCENARIO_MODULE(.refuse_baud = true) },
+    { "slow_boot", "module deaf for 1.5 s after reset", SCENARIO_MODULE(.boot_ms = 1500) },
+    { "warm", "address and ID saved by an earlier boot", SCENARIO_MODULE(), true },
+};
+
+#define SCENARIO_COUNT (sizeof(scenarios) / sizeof(scenarios[0]))
+#define SCENARIO_FLASH_SIZE (FLASH_BANK1_END + 1 - FLASH_BASE)
+
+/* ------------------------------- One run (child) ------------------------------ */
+
+static ScenarioResult_t run_result;
+static uint8_t log_record[3 + 255 + 1];
+static uint16_t log_pos = 0;
+
+/**
+ * @brief Follows the binary log on USART2 record by record (see zigbee_log.h).
+ */
+static void run_log_byte(uint8_t byte)
+{
+    if (log_pos == 0 && byte != ZB_LOG_SYNC) {
+        return;
+    }
+    log_record[log_pos++] = byte;
+    if (log_pos < 3 || log_pos < 3 + log_record[2] + 1) {
+        return;
+    }
+    log_pos = 0;
+
+    uint8_t id = log_record[1];
+    uint8_t len = log_record[2];
+    uint8_t check = id ^ len;
+    for (uint16_t i = 0; i < len; i++) {
+        check ^= log_record[3 + i];
+    }
+    if (check != log_record[3 + len] || id >= ZB_MSG_COUNT) {
+        return;
+    }
+    run_result.log_counts[id]++;
+    if (id == ZB_MSG_STARTUP_TIME && len >= 4 && !run_result.joined) {
+        run_result.joined = true;
+        memcpy(&run_result.joined_ms, &log_record[3], 4);
+    } else if ((id == ZB_MSG_GET_ID_OK || id == ZB_MSG_WARM_BOOT) && !run_result.got_id) {
+        run_result.got_id = true;
+        run_result.warm_boot = (id == ZB_MSG_WARM_BOOT);
+        run_result.id_ms = (uint32_t)(sim_now_us() / 1000);
+    }
+}
+
+static void run_tx(UART_HandleTypeDef *huart, const uint8_t *data, uint16_t len, uint64_t start_us)
+{
+    if (huart == &huart2) {
+        for (uint16_t i = 0; i < len; i++) {
+            run_log_byte(data[i]);
+        }
+    } else {
+        zigbee_module_on_tx(data, len, huart->Init.BaudRate, start_us);
+    }
+}
+
+static void run_child(const Scenario_t *scenario, uint32_t seed, uint32_t limit_s, int fd);
+
+/**
+ * @brief Cold boots in a process of its own until the ID is known and saved.
+ * @param flash Set to the flash contents it left, SCENARIO_FLASH_SIZE bytes.
+ * @return false if the boot did not get that far.
+ */
+static bool run_cold_boot(const Scenario_t *scenario, uint32_t seed, uint32_t limit_s, uint8_t *flash)
+{
+    int fds[2];
+    int status;
+    size_t got = 0;
+    ssize_t n;
+
+    if (pipe(fds) != 0) {
+        return false;
+    }
+    pid_t pid = fork();
+    if (pid < 0) {
+        return false;
+    }
+    if (pid == 0) {
+        Scenario_t cold = *scenario;
+        close(fds[0]);
+        cold.warm = false;
+        run_child(&cold, seed, limit_s, -1);
+        if (!run_result.got_id || write(fds[1], (const void *)FLASH_BASE, SCENARIO_FLASH_SIZE) != SCENARIO_FLASH_SIZE) {
+            _exit(1);
+        }
+        _exit(0);
+    }
+    close(fds[1]);
+    while (got < SCENARIO_FLASH_SIZE && (n = read(fds[0], flash + got, SCENARIO_FLASH_SIZE - got)) > 0) {
+        got += (size_t)n;
+    }
+    close(fds[0]);
+    waitpid(pid, &status, 0);
+    return got == SCENARIO_FLASH_SIZE && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+/**
+ * @brief Boots and runs until the ID is known, then reports through fd, or returns if fd is -1.
+ */
+static void run_child(const Scenario_t *scenario, uint32_t seed, uint32_t limit_s, int fd)
+{
+    static uint8_t flash[SCENARIO_FLASH_SIZE];
+
+    if (scenario->warm && !run_cold_boot(scenario, seed, limit_s, flash)) {
+        _exit(1);
+    }
+    sim_init();
+    if (scenario->warm) {
+        memcpy((void *)FLASH_BASE, flash, SCENARIO_FLASH_SIZE);
+    }
+    sim_set_uid(0x0032FF05u ^ seed, 0x3238510Bu, 0x43117139u); // Spreads the rejoin jitter
+    zigbee_module_init(&scenario->module, seed);
+    sim_set_tx_hook(run_tx);
+    sim_set_gpio_hook(zigbee_module_on_gpio);
+    sim_boot();
+
+    while (!run_result.got_id && sim_now_us() < limit_s * 1000000ull) {
+        sim_run_for(10000);
+    }
+    sim_run_for(100000); // Lets the log of the last steps out, and the parameters be saved
+    if (fd < 0) {
+        return;
+    }
+    run_result.module = *zigbee_module_stats();
+    if (write(fd, &run_result, sizeof(run_result)) != sizeof(run_result)) {
+        _exit(1);
+    }
+    _exit(0);
+}
+
+static bool run_once(const Scenario_t *scenario, uint32_t seed, uint32_t limit_s, ScenarioResult_t *result)
+{
+    int fds[2];
+    int status;
+
+    if (pipe(fds) != 0) {
+        perror("pipe");
+        exit(1);
+    }
+    pid_t pid = fork();
+    if (pid < 0) {
+        perror("fork");
+        exit(1);
+    }
+    if (pid == 0) {
+        close(fds[0]);
+        run_child(scenario, seed, limit_s, fds[1]);
+    }
+    close(fds[1]);
+    bool ok = read(fds[0], result, sizeof(*result)) == sizeof(*result);
+    close(fds[0]);
+    waitpid(pid, &status, 0);
+    return ok && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+/* ---------------------------------- Reports ----------------------------------- */
+
+static bool log_is_retry(uint8_t id)
+{
+    static const char *const marks[] = { "TIMEOUT", "FAIL", "PROBE", "FALLBACK", "OFFLINE", "LEAVE",
+                                         "NOT_JOINED", "BACKOFF", "MALFORMED", "RECHECK" };
+    for (size_t i = 0; i < sizeof(marks) / sizeof(marks[0]); i++) {
+        if (strstr(log_names[id], marks[i]) != NULL) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static int compare_u32(const void *a, const void *b)
+{
+    uint32_t x = *(const uint32_t *)a;
+    uint32_t y = *(const uint32_t *)b;
+    return (x > y) - (x < y);
+}
+
+static void report(const Scenario_t *scenario, const ScenarioResult_t *results, uint32_t runs)
+{
+    uint32_t joined_ms[runs];
+    uint32_t id_ms[runs];
+    uint32_t joined = 0;
+    uint32_t got_id = 0;
+    uint32_t warm_boots = 0;
+    uint64_t log_sum[ZB_MSG_COUNT] = { 0 };
+    uint64_t cmd_sum[ZIGBEE_MODULE_CMD_COUNT] = { 0 };
+    uint64_t dropped = 0, corrupted = 0, garbled = 0, resets = 0;
+
+    for (uint32_t r = 0; r < runs; r++) {
+        const ScenarioResult_t *result = &results[r];
+        if (result->joined) {
+            joined_ms[joined++] = result->joined_ms;
+        }
+        if (result->got_id) {
+            id_ms[got_id++] = result->id_ms;
+        }
+        warm_boots += result->warm_boot;
+        for (uint8_t id = 0; id < ZB_MSG_COUNT; id++) {
+            log_sum[id] += result->log_counts[id];
+        }
+        for (uint8_t cmd = 0; cmd < ZIGBEE_MODULE_CMD_COUNT; cmd++) {
+            cmd_sum[cmd] += result->module.commands[cmd];
+        }
+        dropped += result->module.dropped;
+        corrupted += result->module.corrupted;
+        garbled += result->module.garbled;
+        resets += result->module.resets;
+    }
+    qsort(joined_ms, joined, sizeof(uint32_t), compare_u32);
+    qsort(id_ms, got_id, sizeof(uint32_t), compare_u32);
+
+    printf("%s: %s\n", scenario->name, scenario->description);
+    printf("  joined %u/%u", joined, runs);
+    if (joined != 0) {
+        printf(", time to joined ms: min %u  median %u  max %u", joined_ms[0], joined_ms[joined / 2], joined_ms[joined - 1]);
+    }
+    printf("\n  ID     %u/%u", got_id, runs);
+    if (got_id != 0) {
+        printf(", time to ID ms:     min %u  median %u  max %u", id_ms[0], id_ms[got_id / 2], id_ms[got_id - 1]);
+    }
+    if (scenario->warm) {
+        printf("\n  warm boots %u/%u", warm_boots, runs);
+    }
+    printf("\n  per run:");
+    for (uint8_t id = 0; id < ZB_MSG_COUNT; id++) {
+        if (log_sum[id] != 0 && log_is_retry(id)) {
+            printf(" %s %.1f", log_names[id] + 7, (double)log_sum[id] / runs); // Without "ZB_MSG_"
+        }
+    }
+    printf("\n  module saw per run:");
+    for (uint8_t cmd = 0; cmd < ZIGBEE_MODULE_CMD_COUNT; cmd++) {
+        if (cmd_sum[cmd] != 0) {
+            printf(" %s %.1f", zigbee_module_cmd_names[cmd], (double)cmd_sum[cmd] / runs);
+        }
+    }
+    printf("\n  module: %.1f answers lost, %.1f bytes corrupted, %.1f transfers garbled, %.1f resets per run\n",
+           (double)dropped / runs, (double)corrupted / runs, (double)garbled / runs, (double)resets / runs);
+}
+
+int main(int argc, char **argv)
+{
+    const char *only = NULL;
+    uint32_t runs = 20;
+    uint32_t limit_s = 600;
+    bool verbose = false;
+    bool all_joined = true;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "s:r:t:vl")) != -1) {
+        switch (opt) {
+        case 's':
+            only = optarg;
+            break;
+        case 'r':
+            runs = (uint32_t)strtoul(optarg, NULL, 10);
+            break;
+        case 't':
+            limit_s = (uint32_t)strtoul(optarg, NULL, 10);
+            break;
+        case 'v':
+            verbose = true;
+            break;
+        case 'l':
+            for (size_t i = 0; i < SCENARIO_COUNT; i++) {
+                printf("%-10s %s\n", scenarios[i].name, scenarios[i].description);
+            }
+            return 0;
+        default:
+            fprintf(stderr, "usage: %s [-s scenario] [-r runs] [-t seconds] [-v] [-l]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (runs == 0) {
+        return 1;
+    }
+
+    ScenarioResult_t *results = calloc(runs, sizeof(ScenarioResult_t));
+    bool found = false;
+    for (size_t s = 0; s < SCENARIO_COUNT; s++) {
+        if (only != NULL && strcmp(only, scenarios[s].name) != 0) {
+            continue;
+        }
+        found = true;
+        fflush(stdout); // Not to be written again by every child
+        for (uint32_t r = 0; r < runs; r++) {
+            if (!run_once(&scenarios[s], r + 1, limit_s, &results[r])) {
+                memset(&results[r], 0, sizeof(results[r]));
+                fprintf(stderr, "%s run %u crashed\n", scenarios[s].name, r + 1);
+            }
+            if (verbose) {
+                printf("  %s seed %u: joined %s at %u ms, ID at %u ms\n", scenarios[s].name, r + 1,
+                       results[r].joined ? "yes" : "no", results[r].joined_ms, results[r].id_ms);
+            }
+            all_joined &= results[r].got_id && results[r].warm_boot == scenarios[s].warm;
+        }
+        report(&scenarios[s], results, runs);
+    }
+    free(results);
+    if (!found) {
+        fprintf(stderr, "no scenario %s, -l lists them\n", only);
+        return 1;
+    }
+    return all_joined ? 0 : 2;
+}